@@ -0,0 +1,213 @@
+//------------------------------------------------------------------------------
+// Throughput of the geometry kernels against the straightforward versions they
+// replaced. Not part of the application, build the 589-bench target and run it
+// from a Release build:
+//
+//     589-bench [repetitions]
+//------------------------------------------------------------------------------
+
+#include "CpuFeatures.h"
+#include "Spline.h"
+#include "Transform.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// keeps the compiler from dropping the timed work
+static volatile float sink = 0.f;
+
+// Seconds taken by reps calls of run
+template <typename Run>
+static double seconds(int reps, Run run) {
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < reps; r++) {
+		run();
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::vector<Vertex> controlpolygon(int count) {
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> offset(-1.f, 1.f);
+
+	std::vector<Vertex> E;
+	for (int i = 0; i < count; i++) {
+		E.push_back(Vertex{ glm::vec3(0.1f * float(i), offset(random), offset(random)), glm::vec3(0.f), glm::vec3(0.f) });
+	}
+	return E;
+}
+
+// Line::BSpline() before the batched evaluators: one getvert() per sample
+static void getvertsamples(const std::vector<Vertex>& E, int k, int precision, std::vector<Vertex>& out) {
+	int m = int(E.size()) - 1;
+	const std::vector<float>& U = cachedbasis(k, m);
+	for (int i = 0; i <= precision; i++) {
+		out[size_t(i)].position = getvert(E, U, float(i) / float(precision), k, m);
+	}
+}
+
+static float maxdistance(const std::vector<Vertex>& a, const std::vector<Vertex>& b) {
+	float largest = 0.f;
+	for (size_t i = 0; i < a.size(); i++) {
+		largest = std::max(largest, glm::distance(a[i].position, b[i].position));
+	}
+	return largest;
+}
+
+static void benchsplines(int reps) {
+	const int k = 3;
+	const int precision = 150;
+
+	std::printf("B-Spline evaluation, order %d, %d samples per curve\n", k, precision + 1);
+	std::printf("%8s %14s %14s %14s %10s\n", "ctrl", "getvert/s", "uniform/s", "params/s", "max diff");
+
+	std::vector<float> us(size_t(precision) + 1);
+	for (int i = 0; i <= precision; i++) {
+		us[size_t(i)] = float(i) / float(precision);
+	}
+
+	for (int count : { 20, 80, 300 }) {
+		std::vector<Vertex> E = controlpolygon(count);
+		int m = count - 1;
+		std::vector<Vertex> reference(us.size());
+		std::vector<Vertex> uniform(us.size());
+		std::vector<Vertex> params(us.size());
+
+		double before = seconds(reps, [&]() {
+			getvertsamples(E, k, precision, reference);
+			sink = sink + reference[0].position.x;
+		});
+		double batched = seconds(reps, [&]() {
+			evalBSplineUniform(E.data(), m, k, precision, uniform.data());
+			sink = sink + uniform[0].position.x;
+		});
+		double listed = seconds(reps, [&]() {
+			evalBSpline(E.data(), m, k, us.data(), int(us.size()), params.data());
+			sink = sink + params[0].position.x;
+		});
+
+		double samples = double(reps) * double(us.size());
+		float difference = std::max(maxdistance(reference, uniform), maxdistance(reference, params));
+		std::printf("%8d %14.3g %14.3g %14.3g %10.2g\n", count, samples / before, samples / batched, samples / listed, double(difference));
+	}
+}
+
+static const char* levelname(CPU::SimdLevel level) {
+	switch (level) {
+	case CPU::SIMD_AVX2: return "AVX2";
+	case CPU::SIMD_SSE: return "SSE";
+	default: return "scalar";
+	}
+}
+
+// evalBSpline() at every SIMD level this machine has, against the scalar path
+static void benchsimd(int reps) {
+	const int count = 40;
+	const int params = 300;
+
+	std::vector<float> us(params);
+	for (int i = 0; i < params; i++) {
+		us[size_t(i)] = float(i) / float(params - 1);
+	}
+	std::vector<Vertex> E = controlpolygon(count);
+	std::vector<Vertex> scalar(us.size());
+	std::vector<Vertex> out(us.size());
+
+	std::printf("\nevalBSpline() by SIMD level, %d control points, %d parameters\n", count, params);
+	std::printf("%8s %8s %14s %10s %10s\n", "order", "level", "params/s", "speedup", "max diff");
+
+	CPU::SimdLevel best = CPU::detectSimd();
+	for (int k : { 3, 4, 5 }) {
+		double baseline = 0.0;
+		for (int level = CPU::SIMD_SCALAR; level <= best; level++) {
+			CPU::setSimdLevel(CPU::SimdLevel(level));
+			std::vector<Vertex>& result = (level == CPU::SIMD_SCALAR) ? scalar : out;
+			double time = seconds(reps, [&]() {
+				evalBSpline(E.data(), count - 1, k, us.data(), params, result.data());
+				sink = sink + result[0].position.x;
+			});
+			if (level == CPU::SIMD_SCALAR) {
+				baseline = time;
+			}
+
+			double evaluated = double(reps) * double(params);
+			std::printf("%8d %8s %14.3g %9.2fx %10.2g\n", k, levelname(CPU::SimdLevel(level)), evaluated / time, baseline / time, double(maxdistance(scalar, result)));
+		}
+	}
+	CPU::setSimdLevel(best);
+}
+
+// transformVertices() at every SIMD level, against building the matrix
+// for every vertex like the loops it replaced
+static void benchtransform(int reps) {
+	const int count = 2000;
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> coordinate(-1.f, 1.f);
+	std::vector<Vertex> verts(count);
+	for (Vertex& v : verts) {
+		v.position = glm::vec3(coordinate(random), coordinate(random), coordinate(random));
+		v.normal = glm::normalize(glm::vec3(coordinate(random), coordinate(random), 2.f));
+	}
+
+	// rigid, so repeating it keeps the values in range
+	glm::vec3 offset(0.5f, -0.25f, 1.f);
+	glm::vec3 axis(1.f, 2.f, 0.5f);
+	float angle = 0.7f;
+	glm::mat4 M = glm::translate(glm::mat4(1.f), offset) * glm::rotate(glm::mat4(1.f), angle, axis);
+	glm::mat3 N(M);
+
+	std::printf("\nTransforming %d vertices with normals\n", count);
+	std::printf("%20s %14s %10s %10s\n", "", "verts/s", "speedup", "max diff");
+
+	auto permatrix = [&](std::vector<Vertex>& out) {
+		for (Vertex& v : out) {
+			glm::mat4 T = glm::translate(glm::mat4(1.f), offset) * glm::rotate(glm::mat4(1.f), angle, axis);
+			v.position = T * glm::vec4(v.position, 1.f);
+			v.normal = T * glm::vec4(v.normal, 0.f);
+		}
+	};
+
+	// the differences are after one pass, the timings repeat it in place
+	std::vector<Vertex> reference = verts;
+	permatrix(reference);
+
+	std::vector<Vertex> scratch = verts;
+	double baseline = seconds(reps, [&]() {
+		permatrix(scratch);
+		sink = sink + scratch[0].position.x;
+	});
+	double transformed = double(reps) * double(count);
+	std::printf("%20s %14.3g %9.2fx\n", "matrix per vertex", transformed / baseline, 1.0);
+
+	CPU::SimdLevel best = CPU::detectSimd();
+	for (int level = CPU::SIMD_SCALAR; level <= best; level++) {
+		CPU::setSimdLevel(CPU::SimdLevel(level));
+		std::vector<Vertex> out = verts;
+		transformVertices(out.data(), out.size(), M, N);
+
+		scratch = verts;
+		double time = seconds(reps, [&]() {
+			transformVertices(scratch.data(), scratch.size(), M, N);
+			sink = sink + scratch[0].position.x;
+		});
+		std::printf("%20s %14.3g %9.2fx %10.2g\n", levelname(CPU::SimdLevel(level)), transformed / time, baseline / time, double(maxdistance(reference, out)));
+	}
+	CPU::setSimdLevel(best);
+}
+
+int main(int argc, char** argv) {
+	int reps = (argc > 1) ? std::max(std::atoi(argv[1]), 1) : 2000;
+
+	benchsplines(reps);
+	benchsimd(reps);
+	benchtransform(reps);
+	return 0;
+}
@@ -1,5 +1,6 @@
 #include "Camera.h"
 #include "Geometry.h"
+#include "Transform.h"
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -73,6 +74,17 @@ glm::vec2 Camera::getMousePos(glm::vec4 cursorIn) {
 	return mousePos;
 }
 
+void Camera::getMousePos(const std::vector<Vertex>& points, std::vector<glm::vec2>& out) {
+	glm::mat4 V = getView();
+	float perspectiveMultiplier = glm::tan(glm::radians(22.5f)) * radius;
+
+	out.resize(points.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		glm::vec4 mousePos = V * glm::vec4(points[i].position, 1.f);
+		out[i] = glm::vec2((1 / perspectiveMultiplier) * mousePos);
+	}
+}
+
 void Camera::incrementTheta(float dt) {
 	if (isFixed) return;
 
@@ -109,21 +121,18 @@ std::vector<Vertex> Camera::getcircle(int inc) {
 	std::vector<Vertex> circle;
 	for (int i = 0; i < inc; i++) {
 		float angle = i * 2 * M_PI / inc;
-		glm::vec3 point = glm::rotate(glm::mat4(1.f), -float(M_PI) / 2, up) * glm::inverse(glm::lookAt(eye, at, glm::vec3(0.f, 1.f, 0.f))) * glm::vec4(cos(angle), sin(angle), -radius, 1.f);
-		circle.push_back(Vertex{point, glm::vec3(1.f, 0.7f, 0.f), glm::vec3(0.f, 0.f, 0.f) });
+		circle.push_back(Vertex{ glm::vec3(cos(angle), sin(angle), -radius), glm::vec3(1.f, 0.7f, 0.f), glm::vec3(0.f, 0.f, 0.f) });
 	}
+	glm::mat4 toworld = glm::rotate(glm::mat4(1.f), -float(M_PI) / 2, up) * glm::inverse(glm::lookAt(eye, at, glm::vec3(0.f, 1.f, 0.f)));
+	transformVertices(circle.data(), circle.size(), toworld);
 	return circle;
 }
 
 void Camera::standardize(std::vector<Vertex> &myverts) {
-	std::vector<Vertex> temp;
-
-	for (auto j = myverts.begin(); j < myverts.end(); j++) {
-		// ROTATE W.R.T AXIS
-		glm::vec3 newvert = glm::rotate(glm::mat4(1.f), float(M_PI_2), getUp()) * glm::vec4((*j).position, 1.f);
-		temp.push_back(Vertex{ newvert, glm::vec3(1.f, 0.7f, 0.f), glm::vec3(0.f, 0.f, 0.f) });
+	for (Vertex& v : myverts) {
+		v = Vertex{ v.position, glm::vec3(1.f, 0.7f, 0.f), glm::vec3(0.f, 0.f, 0.f) };
 	}
 
-	myverts.clear();
-	myverts = temp;
+	// ROTATE W.R.T AXIS
+	transformVertices(myverts.data(), myverts.size(), glm::rotate(glm::mat4(1.f), float(M_PI_2), getUp()));
 }
\ No newline at end of file
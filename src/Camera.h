@@ -22,6 +22,8 @@ public:
 	glm::vec4 getCursorPos(glm::vec2 mouseIn);
 	glm::vec4 getCursorPosOP(glm::vec2 mouseIn, glm::vec3 fixed, glm::vec3 nochange, glm::vec3 drawaxis, glm::vec3 axisstart);
 	glm::vec2 getMousePos(glm::vec4 cursorIn);
+	// getMousePos() of every point, with the view matrix built once
+	void getMousePos(const std::vector<Vertex>& points, std::vector<glm::vec2>& out);
 
 	std::vector<Vertex> getcircle(int inc);
 	void standardize(std::vector<Vertex> &myverts);
@@ -0,0 +1,44 @@
+#include "CpuFeatures.h"
+
+#if SIMD_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+
+namespace {
+	CPU::SimdLevel& currentLevel() {
+		static CPU::SimdLevel level = CPU::detectSimd();
+		return level;
+	}
+}
+
+CPU::SimdLevel CPU::detectSimd() {
+#if SIMD_X86 && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return SIMD_SSE;
+
+	// AVX2 also needs the OS to save the YMM registers (OSXSAVE + XCR0 bits 1, 2)
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) return SIMD_SSE;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) ? SIMD_AVX2 : SIMD_SSE;
+#elif SIMD_X86
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") ? SIMD_AVX2 : SIMD_SSE;
+#else
+	return SIMD_SCALAR;
+#endif
+}
+
+CPU::SimdLevel CPU::simdLevel() {
+	return currentLevel();
+}
+
+void CPU::setSimdLevel(SimdLevel level) {
+	SimdLevel best = detectSimd();
+	currentLevel() = (level > best) ? best : level;
+}
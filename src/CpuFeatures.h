@@ -0,0 +1,41 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Runtime detection of the SIMD instruction sets the geometry kernels can use.
+// The kernels are compiled for every level and pick one at runtime, so the
+// same binary still runs on machines without AVX2.
+//------------------------------------------------------------------------------
+
+// SSE/AVX kernels are only built for 64 bit x86, where SSE2 is always present.
+#if defined(__x86_64__) || defined(_M_X64)
+#define SIMD_X86 1
+#else
+#define SIMD_X86 0
+#endif
+
+// Lets GCC/Clang compile a single function for AVX2 without enabling it for
+// the whole build. MSVC allows the intrinsics anywhere.
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET_AVX2
+#endif
+
+namespace CPU {
+
+	enum SimdLevel {
+		SIMD_SCALAR = 0,
+		SIMD_SSE = 1,
+		SIMD_AVX2 = 2
+	};
+
+	// Best level supported by this machine.
+	SimdLevel detectSimd();
+
+	// Level the kernels currently dispatch to. Defaults to detectSimd().
+	SimdLevel simdLevel();
+
+	// Forces a lower level, e.g. to compare against the scalar path. Requests
+	// above what the machine supports are clamped.
+	void setSimdLevel(SimdLevel level);
+}
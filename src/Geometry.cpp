@@ -1,20 +1,155 @@
 #include "Geometry.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <mutex>
 #include <utility>
 
 
+GLuint packNormal(const glm::vec3& n) {
+	// signed normalized, so -1..1 maps to -511..511
+	auto component = [](float f) {
+		int i = int(std::round(glm::clamp(f, -1.f, 1.f) * 511.f));
+		return GLuint(i) & 0x3FFu;
+	};
+	return component(n.x) | (component(n.y) << 10) | (component(n.z) << 20);
+}
+
+
+// verts converted for the upload, shared by every geometry uploading on the
+// thread instead of each one keeping a packed copy of its vertices
+static thread_local std::vector<PackedVertex> packed;
+
+static void pack(const std::vector<Vertex>& verts, size_t first, size_t count, std::vector<PackedVertex>& out) {
+	out.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		const Vertex& v = verts[first + i];
+		out[i] = PackedVertex{ v.position, packNormal(v.normal) };
+	}
+}
+
+
 GPU_Geometry::GPU_Geometry()
-	: vao()
-	, vertBuffer(std::vector<GLint>{3, 3, 3}, sizeof(Vertex))
-	, indexBuffer()
+	: gl()
+	, vertCapacity(0)
+{}
+
+
+GPU_Geometry::~GPU_Geometry() {
+	release(std::move(gl));
+}
+
+
+GPU_Geometry::GPU_Geometry(const GPU_Geometry& other)
+	: gl()
+	, vertCapacity(0)
 {}
 
 
+GPU_Geometry& GPU_Geometry::operator=(const GPU_Geometry& other) {
+	// keeps its GL objects, but what they hold is no longer this geometry's
+	vertCapacity = 0;
+	return *this;
+}
+
+
+GPU_Geometry::GPU_Geometry(GPU_Geometry&& other) noexcept
+	: gl(std::move(other.gl))
+	, vertCapacity(other.vertCapacity)
+{
+	other.vertCapacity = 0;
+}
+
+
+GPU_Geometry& GPU_Geometry::operator=(GPU_Geometry&& other) noexcept {
+	if (this != &other) {
+		release(std::move(gl));
+		gl = std::move(other.gl);
+		vertCapacity = other.vertCapacity;
+		other.vertCapacity = 0;
+	}
+	return *this;
+}
+
+
+GPU_Geometry::Buffers::Buffers()
+	: vao()
+	, vertBuffer()
+{
+	// location 1 (colour) is left disabled, it is a uniform now
+	vertBuffer.attribute(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), offsetof(PackedVertex, position));
+	vertBuffer.attribute(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), offsetof(PackedVertex, normal));
+}
+
+
+// The pool is never freed: whatever is left in it at exit goes with the GL
+// context. It is capped so a burst of temporaries doesn't keep its objects.
+static std::mutex poolMutex;
+static const size_t maxPooled = 256;
+
+std::vector<std::unique_ptr<GPU_Geometry::Buffers>>& GPU_Geometry::pooled() {
+	static auto* pool = new std::vector<std::unique_ptr<Buffers>>();
+	return *pool;
+}
+
+
+std::unique_ptr<GPU_Geometry::Buffers> GPU_Geometry::acquire() {
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		if (!pooled().empty()) {
+			std::unique_ptr<Buffers> buffers = std::move(pooled().back());
+			pooled().pop_back();
+			return buffers;
+		}
+	}
+	return std::make_unique<Buffers>();
+}
+
+
+void GPU_Geometry::release(std::unique_ptr<Buffers> buffers) {
+	if (!buffers) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(poolMutex);
+	if (pooled().size() < maxPooled) {
+		pooled().push_back(std::move(buffers));
+	}
+}
+
+
+GPU_Geometry::Buffers& GPU_Geometry::buffers() {
+	if (!gl) {
+		gl = acquire();
+		vertCapacity = 0;
+	}
+	return *gl;
+}
+
+
 void GPU_Geometry::setVerts(const std::vector<Vertex>& verts) {
-	vertBuffer.uploadData(sizeof(Vertex) * verts.size(), verts.data(), GL_STATIC_DRAW);
+	pack(verts, 0, verts.size(), packed);
+	buffers().vertBuffer.uploadData(sizeof(PackedVertex) * packed.size(), packed.data(), GL_STATIC_DRAW);
+	vertCapacity = verts.size();
+}
+
+
+void GPU_Geometry::updateVerts(const std::vector<Vertex>& verts, size_t first) {
+	updateVerts(verts, first, verts.size() - std::min(first, verts.size()));
 }
 
 
-void GPU_Geometry::setIndices(const std::vector<unsigned int>& indices) {
-	indexBuffer.uploadData(sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
+void GPU_Geometry::updateVerts(const std::vector<Vertex>& verts, size_t first, size_t count) {
+	if (verts.size() > vertCapacity) {
+		vertCapacity = std::max(verts.size(), 2 * vertCapacity);
+		buffers().vertBuffer.uploadData(sizeof(PackedVertex) * vertCapacity, nullptr, GL_DYNAMIC_DRAW);
+		first = 0;
+		count = verts.size();
+	}
+	first = std::min(first, verts.size());
+	count = std::min(count, verts.size() - first);
+	if (count > 0) {
+		pack(verts, first, count, packed);
+		buffers().vertBuffer.updateData(sizeof(PackedVertex) * first, sizeof(PackedVertex) * count, packed.data());
+	}
 }
\ No newline at end of file
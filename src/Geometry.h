@@ -8,11 +8,11 @@
 
 #include "VertexArray.h"
 #include "VertexBuffer.h"
-#include "ElementBuffer.h"
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <memory>
 #include <vector>
 
 struct Vertex
@@ -22,23 +22,70 @@ struct Vertex
 	glm::vec3 normal;
 };
 
-// VAO and two VBOs for storing vertices and colours, respectively
+// What a Vertex is uploaded as: the position, and the normal packed into
+// 10 bits per component (GL_INT_2_10_10_10_REV). Colour is not stored per
+// vertex on the GPU, shaders take it from the objColor uniform.
+struct PackedVertex
+{
+	glm::vec3 position;
+	GLuint normal;
+};
+
+GLuint packNormal(const glm::vec3& n);
+
+// VAO and VBO for storing vertices. Indices are not per object, meshes of
+// the same size share theirs through Topology. The GL objects are only
+// created on first use, so geometry can be built (and thrown away again) on
+// threads without a GL context as long as it is never bound or uploaded
+// there. They come from a pool that destroyed geometry gives its
+// objects back to, so short-lived drawn objects don't create new ones.
+//
+// Copying gives geometry without GL objects (or, when assigning, keeps the
+// ones the target has): only the CPU data is a value, the copy has to be
+// uploaded before it is drawn.
 class GPU_Geometry {
 
 public:
 	GPU_Geometry();
+	~GPU_Geometry();
+
+	GPU_Geometry(const GPU_Geometry& other);
+	GPU_Geometry& operator=(const GPU_Geometry& other);
+	GPU_Geometry(GPU_Geometry&& other) noexcept;
+	GPU_Geometry& operator=(GPU_Geometry&& other) noexcept;
 
 	// Public interface
-	void bind() { vao.bind(); }
+	void bind() { buffers().vao.bind(); }
 
 	void setVerts(const std::vector<Vertex>& verts);
-	void setIndices(const std::vector<unsigned int>& indices);
+	// Uploads only verts[first..], for vertex lists that change at the end.
+	// The buffer grows geometrically, so appending a few vertices per frame
+	// does not re-upload the whole list.
+	void updateVerts(const std::vector<Vertex>& verts, size_t first);
+	// Uploads only verts[first..first + count)
+	void updateVerts(const std::vector<Vertex>& verts, size_t first, size_t count);
 
 private:
-	// note: due to how OpenGL works, vao needs to be 
-	// defined and initialized before the vertex buffers
-	VertexArray vao;
+	struct Buffers {
+		Buffers();
 
-	VertexBuffer vertBuffer;
-	ElementBuffer indexBuffer;
-};
\ No newline at end of file
+		// note: due to how OpenGL works, vao needs to be 
+		// defined and initialized before the vertex buffers
+		VertexArray vao;
+
+		VertexBuffer vertBuffer;
+	};
+
+	Buffers& buffers();
+
+	// the pool of unused GL objects
+	static std::vector<std::unique_ptr<Buffers>>& pooled();
+	static std::unique_ptr<Buffers> acquire();
+	static void release(std::unique_ptr<Buffers> buffers);
+
+	std::unique_ptr<Buffers> gl;
+
+	// number of vertices the vertex buffer has room for, 0 until this
+	// geometry uploaded into it (a pooled buffer still holds old data)
+	size_t vertCapacity;
+};
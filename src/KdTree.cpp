@@ -0,0 +1,69 @@
+#include "KdTree.h"
+
+#include <algorithm>
+
+void KdTree::build(const std::vector<glm::vec3>& points) {
+	nodes.resize(points.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		nodes[i] = Node{ points[i], int(i), 0 };
+	}
+	buildRange(0, int(nodes.size()));
+}
+
+void KdTree::buildRange(int begin, int end) {
+	if (end - begin <= 0) {
+		return;
+	}
+
+	// split along the widest extent of the range
+	glm::vec3 low = nodes[begin].point;
+	glm::vec3 high = nodes[begin].point;
+	for (int i = begin + 1; i < end; i++) {
+		low = glm::min(low, nodes[i].point);
+		high = glm::max(high, nodes[i].point);
+	}
+	glm::vec3 extent = high - low;
+	int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+	int mid = (begin + end) / 2;
+	std::nth_element(nodes.begin() + begin, nodes.begin() + mid, nodes.begin() + end,
+		[axis](const Node& a, const Node& b) { return a.point[axis] < b.point[axis]; });
+	nodes[mid].axis = axis;
+
+	buildRange(begin, mid);
+	buildRange(mid + 1, end);
+}
+
+void KdTree::search(int begin, int end, glm::vec3 q, float& best, int& bestIndex) const {
+	if (end - begin <= 0) {
+		return;
+	}
+
+	int mid = (begin + end) / 2;
+	const Node& node = nodes[mid];
+
+	float distance = glm::distance(node.point, q);
+	if (distance < best || (distance == best && bestIndex != -1 && node.index < bestIndex)) {
+		best = distance;
+		bestIndex = node.index;
+	}
+
+	// near side first, the far side only if the splitting plane is close
+	// enough to still hold something as close (ties included)
+	float offset = q[node.axis] - node.point[node.axis];
+	if (offset < 0) {
+		search(begin, mid, q, best, bestIndex);
+		if (-offset <= best) search(mid + 1, end, q, best, bestIndex);
+	}
+	else {
+		search(mid + 1, end, q, best, bestIndex);
+		if (offset <= best) search(begin, mid, q, best, bestIndex);
+	}
+}
+
+int KdTree::nearest(glm::vec3 q, float maxDistance) const {
+	float best = maxDistance;
+	int bestIndex = -1;
+	search(0, int(nodes.size()), q, best, bestIndex);
+	return bestIndex;
+}
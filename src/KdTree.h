@@ -0,0 +1,40 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// This file contains a static 3D k-d tree for nearest point queries. It is
+// built once from a point set and answers queries in O(log n) expected time,
+// with the same result a linear scan keeping the first strictly closer point
+// would give.
+//------------------------------------------------------------------------------
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class KdTree {
+public:
+
+	KdTree() = default;
+	KdTree(const std::vector<glm::vec3>& points) { build(points); }
+
+	void build(const std::vector<glm::vec3>& points);
+
+	// Index of the point closest to q with distance strictly below maxDistance,
+	// the lowest index on ties, or -1 if there is none.
+	int nearest(glm::vec3 q, float maxDistance) const;
+
+	size_t size() const { return nodes.size(); }
+
+private:
+	struct Node {
+		glm::vec3 point;
+		int index;
+		int axis;
+	};
+
+	// builds nodes[begin, end) as a balanced subtree, median in the middle
+	void buildRange(int begin, int end);
+	void search(int begin, int end, glm::vec3 q, float& best, int& bestIndex) const;
+
+	std::vector<Node> nodes;
+};
@@ -2,13 +2,19 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtx/vector_angle.hpp>
+#include <algorithm>
 #include <vector>
 #include <memory>
+#include <atomic>
 #include <string>
 #include <iostream>
 
 #include "Geometry.h"
+#include "PointPicker.h"
 #include "ShaderProgram.h"
+#include "Spline.h"
+#include "ThreadPool.h"
+#include "Transform.h"
 
 int closestindex(std::vector<Vertex> points, glm::vec3 point, glm::vec3 ref) {
 	int closest = -1;
@@ -24,75 +30,6 @@ int closestindex(std::vector<Vertex> points, glm::vec3 point, glm::vec3 ref) {
 	return closest;
 }
 
-std::vector <float> getbasis(int k, int m) {
-	std::vector <float> basis;
-	for (int i = 1; i <= 3; i++) {
-		if (i == 1) {
-			for (int j = 1; j <= k; j++) {
-				basis.push_back(0);
-			}
-		}
-		else if (i == 2) {
-			for (int j = 1; j < m - k + 2; j++) {
-				float inc = j / double(m - k + 2);
-				basis.push_back(inc);
-			}
-		}
-		else {
-			for (int j = 1; j <= k; j++) {
-				basis.push_back(1);
-			}
-		}
-	}
-	return basis;
-}
-
-// Algorithm to find delta (from A2 and Lecture)
-int delta(std::vector <float> U, float u, int k, int m) {
-	for (int i = 0; i <= m + k - 1; i++) {
-		if (u >= U[i] && u < U[i + 1]) {
-			return i;
-		}
-	}
-	return -1;
-}
-
-// Efficient algorithm to find a value of the B-Spline at a given u value (from A2 and Lecture)
-glm::vec3 getvert(std::vector<Vertex> E, std::vector <float> U, float u, int k, int m) {
-
-	float omega;
-	float denom;
-	int i;
-	int d = delta(U, u, k, m);
-
-	std::vector <glm::vec3> C(k);
-
-	if (d == -1) {
-		d = m;
-	}
-
-	for (i = 0; i <= k - 1; i++) {
-		C[i] = E[d - i].position;
-	}
-
-
-	for (int r = k; r >= 2; r--) {
-		i = d;
-		for (int s = 0; s <= r - 2; s++) {
-			denom = U[i + r - 1] - U[i];
-			if (denom != 0) {
-				omega = (u - U[i]) / denom;
-			}
-			else omega = 0;
-
-			C[s] = omega * C[s] + (1 - omega) * C[s + 1];
-			i = i - 1;
-		}
-	}
-
-	return C[0];
-}
-
 class Line
 {
 public:
@@ -101,6 +38,29 @@ public:
 	bool standardized;
 	glm::vec3 col;
 
+	// control points and precision of the last BSpline(int), which tell
+	// UpdateBSpline() what every sample depends on
+	std::vector<Vertex> splinectrl;
+	int splineprecision;
+
+	// arc length table of the curve with verts as control points, and the
+	// control points it was built from
+	ArcLengthTable arctable;
+	std::vector<glm::vec3> arcctrl;
+
+	// changes every time the vertices are uploaded, so caches built from verts
+	// (like the point picking index) know when to rebuild
+	unsigned int revision;
+
+	// screen space index of verts for picking them with the mouse, rebuilt
+	// when revision, the camera or the window change
+	mutable PointPicker picker;
+
+	static unsigned int nextrevision() {
+		static std::atomic<unsigned int> counter(0);
+		return ++counter;
+	}
+
 	void draw() {
 		geometry.bind();
 		glDrawArrays(GL_LINE_STRIP, 0, GLsizei(verts.size()));
@@ -108,9 +68,14 @@ public:
 	}
 
 	void drawPoints(float pointSize) {
+		drawPoints(pointSize, 0, verts.size());
+	}
+
+	// draws verts[first..first + count) only
+	void drawPoints(float pointSize, size_t first, size_t count) {
 		geometry.bind();
 		glPointSize(pointSize);
-		glDrawArrays(GL_POINTS, 0, GLsizei(verts.size()));
+		glDrawArrays(GL_POINTS, GLint(first), GLsizei(count));
 		glBindVertexArray(0);
 	}
 
@@ -185,6 +150,22 @@ public:
 		}
 	}
 
+	// Replaces a drawn stroke with the control points of its least squares fit
+	void FitBSpline(float tolerance, int maxControlPoints) {
+		std::vector<glm::vec3> stroke;
+		std::vector<glm::vec3> ctrl;
+		for (auto i = verts.begin(); i < verts.end(); i++) {
+			stroke.push_back((*i).position);
+		}
+
+		fitBSpline(stroke, 3, tolerance, maxControlPoints, ctrl);
+
+		verts.clear();
+		for (auto i = ctrl.begin(); i < ctrl.end(); i++) {
+			verts.push_back(Vertex{ (*i), col, glm::vec3(0.f) });
+		}
+	}
+
 	void setColor(glm::vec3 mycolor) {
 		for (auto i = verts.begin(); i < verts.end(); i++) {
 			(*i).color = mycolor;
@@ -192,19 +173,96 @@ public:
 		col = mycolor;
 	}
 
-	void BSpline(int precision, glm::vec3 color) {
+	// With a pool the samples are split between its threads, the result is
+	// the same either way
+	void BSpline(int precision, glm::vec3 color, ThreadPool* pool = nullptr) {
 		col = color;
-		std::vector <Vertex> spline;
-		
-		float u;
-		std::vector<float> basis = getbasis(3, verts.size() - 1);
+		std::vector <Vertex> spline(precision + 1, Vertex{ glm::vec3(0.f), col, glm::vec3(0.f, 0.f, 0.f) });
+
+		const Vertex* E = verts.data();
+		int m = int(verts.size()) - 1;
+		parallelFor(pool, 0, spline.size(), 256, [&](size_t first, size_t last) {
+			evalBSplineUniformRange(E, m, 3, precision, int(first), int(last), spline.data());
+		});
+
+		splinectrl = verts;
+		splineprecision = precision;
+		verts.swap(spline);
+	}
+
+	// Same result as verts = ctrl; BSpline(precision, col); but when only some
+	// control points moved since the last BSpline() only the samples they
+	// reach are evaluated. The samples that changed are verts[first..last).
+	void UpdateBSpline(const std::vector<Vertex>& ctrl, int precision, int& first, int& last) {
+		if (splineprecision != precision || splinectrl.size() != ctrl.size() || verts.size() != size_t(precision) + 1) {
+			verts = ctrl;
+			BSpline(precision, col);
+			first = 0;
+			last = int(verts.size());
+			return;
+		}
+
+		int m = int(ctrl.size()) - 1;
+		first = int(verts.size());
+		last = 0;
+		for (int i = 0; i <= m; i++) {
+			if (ctrl[i].position != splinectrl[i].position) {
+				int a;
+				int b;
+				uniformSamplesOf(3, m, precision, i, a, b);
+				first = std::min(first, a);
+				last = std::max(last, b);
+				splinectrl[i] = ctrl[i];
+			}
+		}
+
+		if (first < last) {
+			evalBSplineUniformRange(splinectrl.data(), m, 3, precision, first, last, verts.data());
+		}
+		else {
+			first = last = 0;
+		}
+	}
+
+	// Samples the curve at the given (sorted) parameter values
+	void BSplineAt(const std::vector<float>& us, glm::vec3 color) {
+		col = color;
+		std::vector <Vertex> spline(us.size(), Vertex{ glm::vec3(0.f), col, glm::vec3(0.f, 0.f, 0.f) });
+
+		evalBSpline(verts.data(), int(verts.size()) - 1, 3, us.data(), int(us.size()), spline.data());
+
+		verts.swap(spline);
+	}
+
+	// Arc length table of the curve verts are the control points of, built on
+	// first use and kept until the control points change
+	const ArcLengthTable& arclength() {
+		bool valid = !arctable.empty() && arcctrl.size() == verts.size();
+		for (size_t i = 0; valid && i < verts.size(); i++) {
+			valid = (arcctrl[i] == verts[i].position);
+		}
 
-		for (int i = 0; i <= precision; i++) {
-			u = double(i) / precision;
-			spline.push_back(Vertex{ getvert(verts, basis, u, 3, verts.size() - 1), col, glm::vec3(0.f, 0.f, 0.f) });
+		if (!valid) {
+			arcctrl.clear();
+			for (auto i = verts.begin(); i < verts.end(); i++) {
+				arcctrl.push_back((*i).position);
+			}
+			arctable.build(verts.data(), int(verts.size()) - 1, 3);
 		}
+		return arctable;
+	}
+
+	// Like BSpline(precision, color) but with the samples evenly spaced in arc length
+	void BSplineArcLength(int precision, glm::vec3 color) {
+		std::vector<float> us;
+		arclength().params(precision + 1, us);
+		BSplineAt(us, color);
+	}
 
-		verts = spline;
+	// Adaptive version of BSpline(), the parameters it picked are returned in us
+	void BSpline(const Tessellation& tess, glm::vec3 color, std::vector<float>& us) {
+		tessellateBSpline(verts.data(), int(verts.size()) - 1, 3, tess, us);
+		BSplineAt(us, color);
 	}
 
 	void MakeCrossSection(Camera current, glm::vec3 fixed) {
@@ -227,12 +285,10 @@ public:
 		glm::mat4 R1 = glm::rotate(glm::mat4(1.f), -dtheta, -current.getPos());
 		glm::mat4 S2 = glm::scale(glm::mat4(1.f), glm::vec3(2 / glm::length(d), 2 / glm::length(d), 2 / glm::length(d)));
 
-		std::vector<Vertex> temp = verts;
-		verts.clear();
-		for (int i = 0; i < temp.size(); i++) {
-			glm::vec3 newp = (S2 * R1 * T1 * glm::vec4(temp[i].position, 1.f));
-			verts.push_back(Vertex{ newp, col, glm::vec3(0.f, 0.f, 0.f) });
+		for (Vertex& v : verts) {
+			v = Vertex{ v.position, col, glm::vec3(0.f, 0.f, 0.f) };
 		}
+		transformVertices(verts.data(), verts.size(), S2 * R1 * T1);
 	}
 
 	void MakeSweep(Camera current, glm::vec3 fixed, glm::vec3 axis){
@@ -250,32 +306,59 @@ public:
 		glm::mat4 S = glm::scale(glm::mat4(1.f), regscale);
 		glm::mat4 S1 = glm::scale(glm::mat4(1.f), scalevec);
 
-		std::vector<Vertex> temp = verts;
-		verts.clear();
-		for (int i = 0; i < temp.size(); i++) {
-			glm::vec3 newp1 = S * glm::vec4(temp[i].position, 1.f);
-			verts.push_back(Vertex{ newp1, col, glm::vec3(0.f, 0.f, 0.f) });
-		}
-		for (int j = temp.size() - 1; j >= 0; j--) {
-			glm::vec3 newp2 = S1 * S * glm::vec4(temp[j].position, 1.f);
-			verts.push_back(Vertex{ newp2, col, glm::vec3(0.f, 0.f, 0.f) });
+		// the stroke, then its mirror image back to the start
+		size_t half = verts.size();
+		for (Vertex& v : verts) {
+			v = Vertex{ v.position, col, glm::vec3(0.f, 0.f, 0.f) };
 		}
+		verts.resize(2 * half);
+		std::reverse_copy(verts.begin(), verts.begin() + half, verts.begin() + half);
+		transformVertices(verts.data(), half, S);
+		transformVertices(verts.data() + half, half, S1 * S);
 	}
 
 	void updateGPU() {
+		revision = nextrevision();
 		geometry.bind();
 		geometry.setVerts(verts);
 	}
 
+	// uploads verts[first..] only, for lines that grow at the end
+	void updateGPU(size_t first) {
+		revision = nextrevision();
+		geometry.bind();
+		geometry.updateVerts(verts, first);
+	}
+
+	// uploads verts[first..first + count) only
+	void updateGPU(size_t first, size_t count) {
+		revision = nextrevision();
+		geometry.bind();
+		geometry.updateVerts(verts, first, count);
+	}
+
+	// the line takes the colour of its first vertex
 	Line(std::vector<Vertex> v)
 		: verts(v)
 		, standardized(false)
-		, col(0,0,0)
+		, col(v.empty() ? glm::vec3(0, 0, 0) : v[0].color)
+		, splinectrl()
+		, splineprecision(-1)
+		, arctable()
+		, arcctrl()
+		, revision(nextrevision())
+		, picker()
 	{}
 
 	Line()
 		: verts()
 		, standardized(false)
 		, col(0,0,0)
+		, splinectrl()
+		, splineprecision(-1)
+		, arctable()
+		, arcctrl()
+		, revision(nextrevision())
+		, picker()
 	{}
 };
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "Lod.h"
+#include "Spline.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/constants.hpp>
+
+// on screen length of the edges the outline is aimed at
+static const float pixelsPerEdge = 6.f;
+// furthest (in pixels) the segments of a ring may cut inside the circle
+static const float pixelsPerChord = 0.5f;
+// how far past a level boundary (in levels) the size has to be to switch
+static const float hysteresis = 0.25f;
+static const int maxLevels = 4;
+// segments and rings the coarsest level keeps at least
+static const int minimumSize = 4;
+
+
+LodChain::LodChain()
+	: chain()
+	, center(0.f)
+	, radius(0.f)
+	, boundsStale(true)
+	, circumference(0.f)
+	, length(0.f)
+	, extentStale(true)
+{}
+
+
+LodChain::LodChain(const LodChain& other)
+	: chain()
+	, center(0.f)
+	, radius(0.f)
+	, boundsStale(true)
+	, circumference(0.f)
+	, length(0.f)
+	, extentStale(true)
+{}
+
+
+LodChain& LodChain::operator=(const LodChain& other) {
+	// keeps its levels' GL objects, they are refilled before being drawn
+	invalidate();
+	return *this;
+}
+
+
+void LodChain::invalidate() {
+	for (Level& level : chain) {
+		level.built = false;
+	}
+	boundsStale = true;
+	extentStale = true;
+}
+
+
+// times count can be halved without going below minimumSize
+static int halvings(int count) {
+	int k = 0;
+	while (k < maxLevels && (count >> (k + 1)) >= minimumSize) {
+		k++;
+	}
+	return k;
+}
+
+LodLevel LodChain::levels(const SurfaceGrid& grid) {
+	return LodLevel{ halvings(grid.segments), halvings(grid.rings) };
+}
+
+
+// count once halved k times, as build() does it
+static int reduced(int count, int k) {
+	int step = 1 << k;
+	return (count + step - 1) / step;
+}
+
+// halvings to use when count should ideally be halved ideal times (any real
+// number), moving away from current only once ideal is clearly past it
+static int pick(int current, float ideal, int coarsest) {
+	current = std::min(std::max(current, 0), coarsest);
+	if (ideal < float(current) - hysteresis || ideal >= float(current + 1) + hysteresis) {
+		current = std::min(std::max(int(std::floor(ideal)), 0), coarsest);
+	}
+	return current;
+}
+
+LodLevel LodChain::select(LodLevel current, float screenRadius, const std::vector<Vertex>& verts, const SurfaceGrid& grid) {
+	LodLevel coarsest = levels(grid);
+	// inside the sphere or behind the camera
+	if (screenRadius <= 0.f || verts.size() != grid.vertexCount()) {
+		return LodLevel();
+	}
+
+	glm::vec3 sphereCenter;
+	float sphereRadius;
+	bounds(verts, sphereCenter, sphereRadius);
+	measure(verts, grid);
+	if (sphereRadius <= 0.f) {
+		return LodLevel();
+	}
+	float pixelsPerUnit = screenRadius / sphereRadius;
+
+	// segments: edges of the widest ring a few pixels long, and no fewer
+	// than the circle that size needs to look round
+	float ringPixels = circumference * pixelsPerUnit;
+	Tessellation round;
+	round.adaptive = true;
+	round.chordTolerance = pixelsPerChord * 2.f * glm::pi<float>() / std::max(ringPixels, 1.f);
+	round.angleTolerance = glm::pi<float>();
+	round.minSamples = minimumSize;
+	round.maxSamples = grid.segments;
+	int roundSegments = circleSegments(round, grid.segments);
+	float segments = std::max(ringPixels / pixelsPerEdge, float(roundSegments));
+
+	LodLevel level;
+	level.segments = pick(current.segments, std::log2(float(grid.segments) / segments), coarsest.segments);
+	while (level.segments > 0 && reduced(grid.segments, level.segments) < roundSegments) {
+		level.segments--;
+	}
+
+	// rings: edges along the axis a few pixels long
+	float rings = std::max(length * pixelsPerUnit / pixelsPerEdge, 1.f);
+	level.rings = pick(current.rings, std::log2(float(grid.rings) / rings), coarsest.rings);
+	return level;
+}
+
+
+void LodChain::bounds(const std::vector<Vertex>& verts, glm::vec3& sphereCenter, float& sphereRadius) {
+	if (boundsStale) {
+		glm::vec3 low(0.f);
+		glm::vec3 high(0.f);
+		if (!verts.empty()) {
+			low = high = verts[0].position;
+		}
+		for (const Vertex& v : verts) {
+			low = glm::min(low, v.position);
+			high = glm::max(high, v.position);
+		}
+
+		center = 0.5f * (low + high);
+		radius = 0.f;
+		for (const Vertex& v : verts) {
+			radius = std::max(radius, glm::distance(center, v.position));
+		}
+		boundsStale = false;
+	}
+
+	sphereCenter = center;
+	sphereRadius = radius;
+}
+
+
+// The longest ring, and the axis as the path from the start cap through
+// the middle of every ring to the end cap
+void LodChain::measure(const std::vector<Vertex>& verts, const SurfaceGrid& grid) {
+	if (!extentStale) {
+		return;
+	}
+
+	circumference = 0.f;
+	length = 0.f;
+	glm::vec3 previous = verts[grid.startcap()].position;
+	for (int r = 0; r < grid.rings; r++) {
+		StridedView<const Vertex> ring = grid.ring(verts.data(), r);
+		float around = 0.f;
+		glm::vec3 middle(0.f);
+		for (size_t s = 0; s < ring.size(); s++) {
+			around += glm::distance(ring[s].position, ring[(s + 1) % ring.size()].position);
+			middle += ring[s].position;
+		}
+		middle /= float(std::max<size_t>(ring.size(), 1));
+
+		circumference = std::max(circumference, around);
+		length += glm::distance(previous, middle);
+		previous = middle;
+	}
+	length += glm::distance(previous, verts[grid.endcap()].position);
+	extentStale = false;
+}
+
+
+void LodChain::build(Level& level, LodLevel reduction, const std::vector<Vertex>& verts, const SurfaceGrid& grid) {
+	int segmentStep = 1 << reduction.segments;
+	int ringStep = 1 << reduction.rings;
+
+	std::vector<int> rings;
+	for (int r = 0; r < grid.rings; r += ringStep) {
+		rings.push_back(r);
+	}
+	if (rings.back() != grid.rings - 1) {
+		rings.push_back(grid.rings - 1);
+	}
+	int segments = reduced(grid.segments, reduction.segments);
+
+	std::vector<Vertex> samples;
+	samples.reserve(2 + rings.size() * size_t(segments));
+	samples.push_back(verts[grid.startcap()]);
+	for (int r : rings) {
+		StridedView<const Vertex> ring = grid.ring(verts.data(), r);
+		for (int s = 0; s < segments; s++) {
+			samples.push_back(ring[size_t(s) * segmentStep]);
+		}
+	}
+	samples.push_back(verts[grid.endcap()]);
+
+	level.topology = Topology::of(SurfaceGrid{ segments, int(rings.size()) });
+	level.geometry.bind();
+	level.geometry.setVerts(samples);
+	level.built = true;
+}
+
+
+bool LodChain::draw(LodLevel level, const std::vector<Vertex>& verts, const SurfaceGrid& grid) {
+	LodLevel coarsest = levels(grid);
+	if (level.full() || verts.size() != grid.vertexCount()
+		|| level.segments < 0 || level.segments > coarsest.segments
+		|| level.rings < 0 || level.rings > coarsest.rings) {
+		return false;
+	}
+
+	chain.resize((maxLevels + 1) * (maxLevels + 1));
+	Level& drawn = chain[size_t(level.segments) * (maxLevels + 1) + size_t(level.rings)];
+	if (!drawn.built) {
+		build(drawn, level, verts, grid);
+	}
+
+	drawn.geometry.bind();
+	drawn.topology->draw();
+	glBindVertexArray(0);
+	return true;
+}
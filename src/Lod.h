@@ -0,0 +1,84 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// This file contains the reduced resolution versions of a grid surface drawn
+// when it is small on screen. A level keeps every 2^s-th segment and every
+// 2^r-th ring of the full grid (and always the last ring), so it samples the
+// same surface at lower ring and sweep counts without evaluating anything
+// again. s and r are picked separately, from how long the rings and the axis
+// are on screen. Levels are built on the GL thread the first time they are
+// drawn after the mesh changed.
+//------------------------------------------------------------------------------
+
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Geometry.h"
+#include "Topology.h"
+
+// How many times the segments and the rings of the full grid are halved
+struct LodLevel {
+	int segments = 0;
+	int rings = 0;
+
+	bool full() const { return segments == 0 && rings == 0; }
+};
+
+class LodChain {
+public:
+
+	LodChain();
+
+	// Copies are rebuilt the next time they are drawn, like GPU_Geometry
+	// only the mesh's CPU data is a value
+	LodChain(const LodChain& other);
+	LodChain& operator=(const LodChain& other);
+	LodChain(LodChain&& other) noexcept = default;
+	LodChain& operator=(LodChain&& other) noexcept = default;
+
+	// The mesh changed, levels and bounds are rebuilt when next needed
+	void invalidate();
+
+	// Most times the segments and the rings of grid can be halved, none for
+	// grids already coarse
+	static LodLevel levels(const SurfaceGrid& grid);
+
+	// Level to draw the mesh with verts laid out as grid at when its bounding
+	// sphere is screenRadius pixels across on screen. The segments follow the
+	// widest ring's circumference, but never drop below what circleSegments()
+	// gives for a circle that size; the rings follow the axis length. current
+	// is the level drawn so far, each count is kept until the size is clearly
+	// past the next one's, so objects don't pop back and forth at a boundary.
+	LodLevel select(LodLevel current, float screenRadius, const std::vector<Vertex>& verts, const SurfaceGrid& grid);
+
+	// Sphere around verts, cached until invalidate()
+	void bounds(const std::vector<Vertex>& verts, glm::vec3& center, float& radius);
+
+	// Draws level (not the full grid) of the mesh with verts laid out as
+	// grid, false if it has no such level. GL thread only.
+	bool draw(LodLevel level, const std::vector<Vertex>& verts, const SurfaceGrid& grid);
+
+private:
+	struct Level {
+		bool built = false;
+		std::shared_ptr<const Topology> topology;
+		GPU_Geometry geometry;
+	};
+
+	void measure(const std::vector<Vertex>& verts, const SurfaceGrid& grid);
+	void build(Level& level, LodLevel reduction, const std::vector<Vertex>& verts, const SurfaceGrid& grid);
+
+	// built lazily, indexed by the segment and ring halvings
+	std::vector<Level> chain;
+
+	glm::vec3 center;
+	float radius;
+	bool boundsStale;
+
+	// longest ring and axis length, in world units
+	float circumference;
+	float length;
+	bool extentStale;
+};
@@ -2,6 +2,7 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtx/vector_angle.hpp>
+#include <algorithm>
 #include <vector>
 #include <memory>
 #include <string>
@@ -11,8 +12,14 @@
 #include "ShaderProgram.h"
 #include "Line.h"
 #include "Camera.h"
-
-void orderlines(std::vector<Vertex>& Line1, std::vector<Vertex>& Line2) {
+#include "KdTree.h"
+#include "Lod.h"
+#include "ThreadPool.h"
+#include "Topology.h"
+#include "Transform.h"
+
+// true if Line2 runs the other way from Line1 (its far end is closer)
+bool linesreversed(const std::vector<Vertex>& Line1, const std::vector<Vertex>& Line2) {
 	float dist1 = glm::distance(Line1[0].position, Line2[0].position);
 	float dist2 = glm::distance(Line1[0].position, Line2[Line2.size() - 1].position);
 	float dist3 = glm::distance(Line1[Line1.size() - 1].position, Line2[0].position);
@@ -22,12 +29,16 @@ void orderlines(std::vector<Vertex>& Line1, std::vector<Vertex>& Line2) {
 
 	int min = std::distance(std::begin(distances), std::min_element(std::begin(distances), std::end(distances)));
 
-	if (min == 1 || min == 2) {
+	return (min == 1 || min == 2);
+}
+
+void orderlines(std::vector<Vertex>& Line1, std::vector<Vertex>& Line2) {
+	if (linesreversed(Line1, Line2)) {
 		std::reverse(Line2.begin(), Line2.end());
 	}
 }
 
-glm::vec3 closestvec(std::vector<Vertex> points, glm::vec3 point, glm::vec3 ref) {
+glm::vec3 closestvec(const std::vector<Vertex>& points, glm::vec3 point, glm::vec3 ref) {
 	glm::vec3 closest = glm::vec3 (10.f, 10.f, 10.f);
 	float min = 10.f;
 
@@ -41,96 +52,171 @@ glm::vec3 closestvec(std::vector<Vertex> points, glm::vec3 point, glm::vec3 ref)
 	return closest;
 }
 
-std::vector<Vertex> centeraxis(Line l1, Line l2, int sprecision) {
-	l1.BSpline(sprecision, glm::vec3(0.f));
-	l2.BSpline(sprecision, glm::vec3(0.f));
-
-	std::vector<Vertex> axis;
-	std::vector<Vertex> Spline1 = l1.verts;
-	std::vector<Vertex> Spline2 = l2.verts;
-
-	orderlines(Spline1, Spline2);
-
-	for (int i = 0; i <= sprecision; i++) {
-		glm::vec3 cvert = 0.5f * Spline1[i].position + 0.5f * Spline2[i].position;
-		axis.push_back(Vertex{ cvert, glm::vec3(1.f, 0.7f, 0.f), glm::vec3(0.f) });
+// Index for closestvec() queries against the same points and ref
+KdTree closestvecindex(const std::vector<Vertex>& points, glm::vec3 ref) {
+	std::vector<glm::vec3> keys;
+	keys.reserve(points.size());
+	for (auto i = points.begin(); i < points.end(); i++) {
+		keys.push_back(ref * (*i).position);
 	}
+	return KdTree(keys);
+}
 
-	return axis;
+// Same result as closestvec(points, point, ref), tree from closestvecindex(points, ref)
+glm::vec3 closestvec(const std::vector<Vertex>& points, const KdTree& tree, glm::vec3 point, glm::vec3 ref) {
+	int i = tree.nearest(ref * point, 10.f);
+	return (i == -1) ? glm::vec3(10.f, 10.f, 10.f) : points[i].position;
 }
 
-void updateindices(std::vector<unsigned int> &indices, int sweepsize, int sprecision) {
-	indices.clear();
-	
-	for (int i = 1; i <= sweepsize; i++) {
-		if (i == sweepsize) {
-			indices.push_back(0 + 1);
-			indices.push_back(0);
-			indices.push_back(i);
+// Samples the two boundary curves so that Spline1[i] pairs with Spline2[i],
+// with their derivatives along the rings in Tangent1/Tangent2. Uniform
+// tessellation takes sprecision + 1 samples of each (evenly spaced in
+// parameter or in arc length); adaptive tessellation samples both at the
+// union of the parameters either one asks for.
+void sampleboundaries(Line& ctrl1, Line& ctrl2, int sprecision, const Tessellation& tess, std::vector<Vertex>& Spline1, std::vector<Vertex>& Spline2, std::vector<glm::vec3>& Tangent1, std::vector<glm::vec3>& Tangent2) {
+	std::vector<Vertex> E1 = ctrl1.verts;
+	std::vector<Vertex> E2 = ctrl2.verts;
+	int m1 = int(E1.size()) - 1;
+	int m2 = int(E2.size()) - 1;
+	Vertex zero = Vertex{ glm::vec3(0.f), glm::vec3(0.f), glm::vec3(0.f) };
+
+	if (tess.adaptive) {
+		// the curves start and end on their end control points, so they can be
+		// put in the same direction before the parameters are merged
+		orderlines(E1, E2);
+
+		// tess.maxSamples caps the rings, not each curve: while the union is
+		// over it both curves are tessellated again with a smaller budget
+		std::vector<float> us1;
+		std::vector<float> us2;
+		std::vector<float> us;
+		Tessellation budget = tess;
+		while (true) {
+			tessellateBSpline(E1.data(), m1, 3, budget, us1);
+			tessellateBSpline(E2.data(), m2, 3, budget, us2);
+			mergeparameters(us1, us2, us);
+			int over = int(us.size()) - tess.maxSamples;
+			if (over <= 0 || budget.maxSamples <= budget.minSamples) {
+				break;
+			}
+			budget.maxSamples = std::max(budget.maxSamples - std::max(over / 2, 1), budget.minSamples);
 		}
-		else {
-			indices.push_back(i + 1);
-			indices.push_back(0);
-			indices.push_back(i);
+
+		// the starting samples and knots alone can still be too many
+		if (us.size() > size_t(std::max(tess.maxSamples, 2))) {
+			std::vector<float> all;
+			all.swap(us);
+			size_t keep = size_t(std::max(tess.maxSamples, 2));
+			for (size_t i = 0; i < keep; i++) {
+				us.push_back(all[i * (all.size() - 1) / (keep - 1)]);
+			}
 		}
+
+		int n = int(us.size());
+		Spline1.assign(n, zero);
+		Spline2.assign(n, zero);
+		Tangent1.resize(n);
+		Tangent2.resize(n);
+		evalBSpline(E1.data(), m1, 3, us.data(), n, Spline1.data());
+		evalBSpline(E2.data(), m2, 3, us.data(), n, Spline2.data());
+		evalBSplineDerivatives(E1.data(), m1, 3, us.data(), n, Tangent1.data(), nullptr);
+		evalBSplineDerivatives(E2.data(), m2, 3, us.data(), n, Tangent2.data(), nullptr);
+		return;
 	}
 
-	// creating faces using vertex indices
-	for (int i = 1; i <= sweepsize; i++) {
-		for (int j = 0; j <= sprecision; j++) {
-			if (i != sweepsize) {
-				if (j != 0) {
-					indices.push_back((sweepsize) * j + i + 1);
-					indices.push_back((sweepsize) * (j - 1) + i + 1);
-					indices.push_back((sweepsize) * j + i - 1 + 1);
-				}
-				if (j != sprecision) {
-					indices.push_back((sweepsize) * j + i + 1);
-					indices.push_back((sweepsize) * j + i - 1 + 1);
-					indices.push_back((sweepsize) * (j + 1) + i - 1 + 1);
-				}
-			}
-			else {
-				if (j != 0) {
-					indices.push_back((sweepsize) * (j)+0 + 1);
-					indices.push_back((sweepsize) * (j - 1) + 0 + 1);
-					indices.push_back((sweepsize) * (j)+sweepsize - 1 + 1);
-				}
-				if (j != sprecision) {
-					indices.push_back((sweepsize) * j + 0 + 1);
-					indices.push_back((sweepsize) * j + sweepsize - 1 + 1);
-					indices.push_back((sweepsize) * (j + 1) + sweepsize - 1 + 1);
-				}
-			}
+	int n = sprecision + 1;
+	Spline1.assign(n, zero);
+	Spline2.assign(n, zero);
+	Tangent1.resize(n);
+	Tangent2.resize(n);
+
+	if (tess.arcLength) {
+		// each curve evenly in its own arc length, the tables stay cached on
+		// the control point lines between regenerations
+		std::vector<float> us1;
+		std::vector<float> us2;
+		ctrl1.arclength().params(n, us1);
+		ctrl2.arclength().params(n, us2);
+
+		evalBSpline(E1.data(), m1, 3, us1.data(), n, Spline1.data());
+		evalBSpline(E2.data(), m2, 3, us2.data(), n, Spline2.data());
+		evalBSplineDerivatives(E1.data(), m1, 3, us1.data(), n, Tangent1.data(), nullptr);
+		evalBSplineDerivatives(E2.data(), m2, 3, us2.data(), n, Tangent2.data(), nullptr);
+
+		// the ring parameter is the fraction of arc length, so each curve
+		// moves at its own length per unit
+		float length1 = ctrl1.arclength().length();
+		float length2 = ctrl2.arclength().length();
+		for (int i = 0; i < n; i++) {
+			if (glm::length(Tangent1[i]) > 0) Tangent1[i] *= length1 / glm::length(Tangent1[i]);
+			if (glm::length(Tangent2[i]) > 0) Tangent2[i] *= length2 / glm::length(Tangent2[i]);
 		}
 	}
+	else {
+		evalBSplineUniform(E1.data(), m1, 3, sprecision, Spline1.data());
+		evalBSplineUniform(E2.data(), m2, 3, sprecision, Spline2.data());
+		evalBSplineUniformDerivatives(E1.data(), m1, 3, sprecision, Tangent1.data(), nullptr);
+		evalBSplineUniformDerivatives(E2.data(), m2, 3, sprecision, Tangent2.data(), nullptr);
+	}
 
-	for (int i = 1; i <= sweepsize; i++) {
-		indices.push_back(sweepsize * (sprecision + 1) - (i - 1));
-		indices.push_back(sweepsize * (sprecision + 1) + 1);
-		indices.push_back(sweepsize * (sprecision + 1) - (i - 2));
-		if (i == sweepsize) {
-			indices.push_back(sweepsize * (sprecision + 1) - 0);
-			indices.push_back(sweepsize * (sprecision + 1) + 1);
-			indices.push_back(sweepsize * (sprecision + 1) - (i - 1));
+	if (linesreversed(Spline1, Spline2)) {
+		std::reverse(Spline2.begin(), Spline2.end());
+		std::reverse(Tangent2.begin(), Tangent2.end());
+		for (auto t = Tangent2.begin(); t < Tangent2.end(); t++) {
+			(*t) = -(*t);
 		}
 	}
 }
 
+// Unit normal of the surface at the point offset q from its ring's center,
+// from the derivatives along the rings (du) and around the ring (dj), facing
+// away from the center
+glm::vec3 surfacenormal(glm::vec3 du, glm::vec3 dj, glm::vec3 q) {
+	glm::vec3 normal = glm::cross(du, dj);
+	if (glm::length(normal) <= 1e-12f) {
+		normal = q;
+	}
+	if (glm::dot(normal, q) < 0) {
+		normal = -normal;
+	}
+	return (glm::length(normal) > 0) ? glm::normalize(normal) : glm::vec3(0.f);
+}
+
+std::vector<Vertex> centeraxis(Line& l1, Line& l2, int sprecision, const Tessellation& tess = Tessellation()) {
+	std::vector<Vertex> axis;
+	std::vector<Vertex> Spline1;
+	std::vector<Vertex> Spline2;
+	std::vector<glm::vec3> Tangent1;
+	std::vector<glm::vec3> Tangent2;
+
+	sampleboundaries(l1, l2, sprecision, tess, Spline1, Spline2, Tangent1, Tangent2);
+
+	for (size_t i = 0; i < Spline1.size(); i++) {
+		glm::vec3 cvert = 0.5f * Spline1[i].position + 0.5f * Spline2[i].position;
+		axis.push_back(Vertex{ cvert, glm::vec3(1.f, 0.7f, 0.f), glm::vec3(0.f) });
+	}
+
+	return axis;
+}
+
 class Mesh
 {
 public:
+	// laid out as topology->grid() says, ring by ring
 	std::vector<Vertex> verts;
-	std::vector<unsigned int> indices;
+	// shared with every mesh of the same size, see Topology::of()
+	std::shared_ptr<const Topology> topology;
 
 	std::vector<Vertex> axis;
-	std::vector<std::vector<Vertex>> discs;
 
 	float height;
 	float width;
 
 	glm::vec3 color;
 
+	// how the boundary curves are sampled into rings
+	Tessellation tess;
+
 	Line crosssection;
 	Line sweep;
 
@@ -147,6 +233,14 @@ public:
 
 	GPU_Geometry geometry;
 
+	// reduced versions for drawing it small, and the one drawn last frame
+	LodChain lod;
+	LodLevel lodLevel;
+
+	// rigid transform create() applies to what it builds, pinched surfaces
+	// are sampled in canonicalframe() and placed in one pass
+	glm::mat4 placement = glm::mat4(1.f);
+
 	std::vector<Vertex> stdgetdisc(glm::vec3 cvert, glm::vec3 diameter, float theta) {
 		std::vector<Vertex> disc;
 
@@ -157,9 +251,9 @@ public:
 		glm::mat4 T = glm::translate(glm::mat4(1.f), cvert);
 
 		for (int j = 0; j < sweep.verts.size(); j++) {
-			glm::vec3 point = T * R * S * glm::vec4(sweep.verts[j].position, 1.f);
-			disc.emplace_back(Vertex{ glm::vec4(point, 1.f), color, glm::vec3(0.f)});
+			disc.emplace_back(Vertex{ sweep.verts[j].position, color, glm::vec3(0.f)});
 		}
+		transformVertices(disc.data(), disc.size(), T * R * S);
 
 		return disc;
 	}
@@ -184,6 +278,32 @@ public:
 		return point;
 	}
 
+	// The frame profiles are drawn and pinched surfaces built in: the axis
+	// turned to the camera's up and centered on the origin. toworld takes it
+	// back to the surface. Worked out from the end control points of the
+	// boundaries (the curves start and end on them), so it is the axis
+	// create() would sample, without building anything.
+	void canonicalframe(glm::mat4& toworld, glm::mat4& tolocal) {
+		std::vector<Vertex> E1 = ctrlpts1.verts;
+		std::vector<Vertex> E2 = ctrlpts2.verts;
+		orderlines(E1, E2);
+		glm::vec3 start = 0.5f * (E1.front().position + E2.front().position);
+		glm::vec3 end = 0.5f * (E1.back().position + E2.back().position);
+		glm::vec3 center = 0.5f * (start + end);
+		glm::vec3 axis = glm::normalize(end - start);
+
+		// fix angle
+		// first isolate to direction of up
+		glm::vec3 testup = axis * cam.getUp();
+		if ((testup.x + testup.y + testup.z) < 0) {
+			axis = axis * (glm::vec3(-1.f));
+		}
+		float theta = glm::orientedAngle(cam.getUp(), axis, -cam.getPos());
+
+		toworld = glm::translate(glm::mat4(1.f), center) * glm::rotate(glm::mat4(1.f), theta, -cam.getPos());
+		tolocal = glm::rotate(glm::mat4(1.f), -theta, -cam.getPos()) * glm::translate(glm::mat4(1.f), -center);
+	}
+
 	Mesh gettempmesh() {
 		Mesh tempmesh;
 		tempmesh.ctrlpts1 = Line(ctrlpts1.verts);
@@ -193,191 +313,409 @@ public:
 		tempmesh.pinch2 = Line(tempmesh.pinch2.verts);
 		tempmesh.cam = cam;
 		tempmesh.color = color;
+		tempmesh.tess = tess;
 
-		glm::vec3 axis = getAxis();
+		glm::mat4 toworld;
+		glm::mat4 tolocal;
+		canonicalframe(toworld, tolocal);
 
-		// fix angle
-		// first isolate to direction of up
-		glm::vec3 testup = axis * cam.getUp();
-		if ((testup.x + testup.y + testup.z) < 0) {
-			axis = axis * (glm::vec3(-1.f));
-		}
-		float profiletheta = glm::orientedAngle(cam.getUp(), axis, -cam.getPos());
+		transformVertices(tempmesh.ctrlpts1.verts.data(), tempmesh.ctrlpts1.verts.size(), tolocal);
+		transformVertices(tempmesh.ctrlpts2.verts.data(), tempmesh.ctrlpts2.verts.size(), tolocal);
 
-		for (auto j = tempmesh.ctrlpts1.verts.begin(); j < tempmesh.ctrlpts1.verts.end(); j++) {
-			(*j).position = glm::rotate(glm::mat4(1.f), -profiletheta, -cam.getPos()) * glm::translate(glm::mat4(1.f), -getCenter()) * glm::vec4((*j).position, 1.f);
+		return tempmesh;
+	}
+
+	// Everything the rings are built from, sampled once per create()/update()
+	struct RingInputs {
+		std::vector<Vertex> Spline1;
+		std::vector<Vertex> Spline2;
+		std::vector<glm::vec3> Tangent1;
+		std::vector<glm::vec3> Tangent2;
+
+		bool pinched;
+		std::vector<Vertex> pinchpoints1;
+		std::vector<Vertex> pinchpoints2;
+		// pinch curve derivatives at the same samples, for the normals
+		std::vector<glm::vec3> pinchtangent1;
+		std::vector<glm::vec3> pinchtangent2;
+		KdTree pinchtree1;
+		KdTree pinchtree2;
+		glm::vec3 pinchref;
+
+		// derivative of the cross section around the ring (it is a closed loop)
+		std::vector<glm::vec3> sweeptangent;
+
+		glm::vec3 rotaxis;		// the rings are rotated about -cam.getPos()
+		glm::vec3 along;		// components the pinch curves scale
+		glm::vec3 across;
+	};
+
+	// Where a ring sits: its center on the axis (before pinching) and its
+	// final center, with their derivatives along the rings
+	struct RingFrame {
+		glm::vec3 axis;
+		glm::vec3 daxis;
+		glm::vec3 center;
+		glm::vec3 dcenter;
+	};
+
+	void sampleinputs(int sprecision, RingInputs& in, ThreadPool* pool) {
+		sampleboundaries(ctrlpts1, ctrlpts2, sprecision, tess, in.Spline1, in.Spline2, in.Tangent1, in.Tangent2);
+
+		in.pinched = pinch1.verts.size() > 0 && pinch2.verts.size() > 0;
+		in.pinchpoints1.clear();
+		in.pinchpoints2.clear();
+
+		if (in.pinched) {
+			Line temppinch1 = Line(pinch1.verts);
+			Line temppinch2 = Line(pinch2.verts);
+			temppinch1.BSpline(2 * sprecision, glm::vec3(0.f, 0.f, 0.f), pool);
+			temppinch2.BSpline(2 * sprecision, glm::vec3(0.f, 0.f, 0.f), pool);
+			in.pinchpoints1.swap(temppinch1.verts);
+			in.pinchpoints2.swap(temppinch2.verts);
+
+			in.pinchtangent1.resize(2 * sprecision + 1);
+			in.pinchtangent2.resize(2 * sprecision + 1);
+			evalBSplineUniformDerivatives(pinch1.verts.data(), int(pinch1.verts.size()) - 1, 3, 2 * sprecision, in.pinchtangent1.data(), nullptr);
+			evalBSplineUniformDerivatives(pinch2.verts.data(), int(pinch2.verts.size()) - 1, 3, 2 * sprecision, in.pinchtangent2.data(), nullptr);
 		}
 
-		for (auto i = tempmesh.ctrlpts2.verts.begin(); i < tempmesh.ctrlpts2.verts.end(); i++) {
-			(*i).position = glm::rotate(glm::mat4(1.f), -profiletheta, -cam.getPos()) * glm::translate(glm::mat4(1.f), -getCenter()) * glm::vec4((*i).position, 1.f);
+		// every ring looks up its closest pinch samples, index them once
+		in.pinchref = cam.getUp();
+		in.pinchtree1 = closestvecindex(in.pinchpoints1, in.pinchref);
+		in.pinchtree2 = closestvecindex(in.pinchpoints2, in.pinchref);
+
+		int sweepsize = int(sweep.verts.size());
+		in.sweeptangent.resize(sweepsize);
+		for (int j = 0; j < sweepsize; j++) {
+			in.sweeptangent[j] = sweep.verts[(j + 1) % sweepsize].position - sweep.verts[(j + sweepsize - 1) % sweepsize].position;
 		}
 
-		return tempmesh;
+		glm::vec3 camdir = glm::normalize(cam.getPos());
+		in.rotaxis = -camdir;
+		in.along = glm::abs(camdir);
+		in.across = glm::vec3(1.f) - in.along;
 	}
 
-	void create(int sprecision) {
-		discs.clear();
-		verts.clear();
-		indices.clear();
-		axis.clear();
+	// Builds ring i, positions and normals, into disc
+	RingFrame buildring(const RingInputs& in, int i, std::vector<Vertex>& disc) {
+		RingFrame frame;
 
-		Line bound1 = Line(ctrlpts1.verts);
-		Line bound2 = Line(ctrlpts2.verts);
+		glm::vec3 cvert = 0.5f * (in.Spline1[i].position + in.Spline2[i].position);
+		glm::vec3 dcvert = 0.5f * (in.Tangent1[i] + in.Tangent2[i]);
+		frame.axis = cvert;
+		frame.daxis = dcvert;
 
-		bound1.BSpline(sprecision, glm::vec3(0.f));
-		bound2.BSpline(sprecision, glm::vec3(0.f));
+		glm::vec3 diameter = (in.Spline1[i].position - in.Spline2[i].position);
+		glm::vec3 ddiameter = in.Tangent1[i] - in.Tangent2[i];
+		float length = glm::length(diameter);
+		float scale = (1.f / height) * length;
+		float theta = glm::orientedAngle(glm::normalize(cam.getUp()), glm::normalize(diameter), -glm::normalize(cam.getPos()));
 
-		std::vector<Vertex> Spline1 = bound1.verts;
-		std::vector<Vertex> Spline2 = bound2.verts;
+		// how fast the diameter grows and turns along the rings
+		float dlength = (length > 0) ? glm::dot(diameter, ddiameter) / length : 0.f;
+		float dtheta = (length > 0) ? glm::dot(in.rotaxis, glm::cross(diameter, ddiameter)) / (length * length) : 0.f;
 
-		Line temppinch1;
-		Line temppinch2;
+		glm::mat4 R = glm::rotate(glm::mat4(1.f), theta, -cam.getPos());
+		glm::mat3 R3(R);
+
+		if (in.pinched) {
+			int i1 = in.pinchtree1.nearest(in.pinchref * cvert, 10.f);
+			int i2 = in.pinchtree2.nearest(in.pinchref * cvert, 10.f);
+			glm::vec3 P1 = (i1 == -1) ? glm::vec3(10.f, 10.f, 10.f) : in.pinchpoints1[i1].position;
+			glm::vec3 P2 = (i2 == -1) ? glm::vec3(10.f, 10.f, 10.f) : in.pinchpoints2[i2].position;
+
+			// the matched pinch points slide along their curves to keep
+			// level with the ring
+			glm::vec3 dP1 = glm::vec3(0.f);
+			glm::vec3 dP2 = glm::vec3(0.f);
+			if (i1 != -1 && std::abs(glm::dot(in.pinchref, in.pinchtangent1[i1])) > 1e-6f) {
+				dP1 = in.pinchtangent1[i1] * (glm::dot(in.pinchref, dcvert) / glm::dot(in.pinchref, in.pinchtangent1[i1]));
+			}
+			if (i2 != -1 && std::abs(glm::dot(in.pinchref, in.pinchtangent2[i2])) > 1e-6f) {
+				dP2 = in.pinchtangent2[i2] * (glm::dot(in.pinchref, dcvert) / glm::dot(in.pinchref, in.pinchtangent2[i2]));
+			}
 
-		temppinch1 = Line(pinch1.verts);
-		temppinch2 = Line(pinch2.verts);
+			glm::vec3 pdiameter = P2 - P1;
+			glm::vec3 dpdiameter = dP2 - dP1;
 
-		if (temppinch1.verts.size() > 0 && temppinch2.verts.size() > 0) {
-			temppinch1.BSpline(2 * sprecision, glm::vec3(0.f, 0.f, 0.f));
-			temppinch2.BSpline(2 * sprecision, glm::vec3(0.f, 0.f, 0.f));
-		}
+			cvert = cvert * (glm::vec3(1.f) - glm::abs(glm::normalize(cam.getPos()))) + (0.5f * (P1 + P2) * glm::abs(glm::normalize(cam.getPos())));
+			dcvert = dcvert * in.across + 0.5f * (dP1 + dP2) * in.along;
 
-		glm::vec3 cvert = glm::vec3(0.f);
-		glm::vec3 diameter = glm::vec3(0.f);
-		glm::vec3 pdiameter = glm::vec3(0.f);
+			float pscale = (1.f / width) * glm::length(pdiameter);
+			float dpscale = (glm::length(pdiameter) > 0) ? glm::dot(pdiameter, dpdiameter) / (glm::length(pdiameter) * width) : 0.f;
 
-		float pscale;
-		float scale;
-		float theta;
+			glm::vec3 scaleby = pscale * glm::abs(glm::normalize(cam.getPos())) + scale * (glm::vec3(1.f) - glm::abs(glm::normalize(cam.getPos())));
+			glm::vec3 dscaleby = dpscale * in.along + (dlength / height) * in.across;
 
-		height = glm::distance(sweep.verts[0].position,sweep.verts[floor(sweep.verts.size() / 2)].position);
-		width = glm::distance(sweep.verts[floor(1 * sweep.verts.size() / 4)].position, sweep.verts[floor(3 * sweep.verts.size() / 4)].position);
+			glm::mat4 S = glm::scale(glm::mat4(1.f), scaleby);
+			glm::mat4 T = glm::translate(glm::mat4(1.f), cvert);
 
-		orderlines(Spline1, Spline2);
-		std::vector<Vertex> disc;
+			disc.clear();
+			for (size_t j = 0; j < sweep.verts.size(); j++) {
+				disc.push_back(Vertex{ sweep.verts[j].position, color, glm::vec3(0.f) });
+			}
+			transformVertices(disc.data(), disc.size(), T * R * S);
 
-		for (int i = 0; i <= sprecision; i++) {
-			cvert = 0.5f * (Spline1[i].position + Spline2[i].position);
-			axis.push_back(Vertex{ glm::vec4(cvert, 1.f), color, glm::vec3(0.f, 0.f, 0.f) });
+			for (size_t j = 0; j < sweep.verts.size(); j++) {
+				glm::vec3 q = disc[j].position - cvert;
+				glm::vec3 du = dcvert + R3 * (dscaleby * sweep.verts[j].position) + dtheta * glm::cross(in.rotaxis, q);
+				glm::vec3 dj = R3 * (scaleby * in.sweeptangent[j]);
 
-			if (i == 0) {
-				glm::vec3 cvertnext = 0.5f * Spline1[i+1].position + 0.5f * Spline2[i+1].position;
-				verts.emplace_back(Vertex{ glm::vec4(cvert, 1.f), color, glm::normalize(cvert - cvertnext)});
+				disc[j].normal = surfacenormal(du, dj, q);
+			}
+		} else {
+			disc = stdgetdisc(cvert, diameter, theta);
+
+			// stdgetdisc() scales the cross section by half the diameter
+			float radius = 0.5f * length;
+			float growth = (radius > 0) ? 0.5f * dlength / radius : 0.f;
+
+			for (size_t j = 0; j < disc.size(); j++) {
+				glm::vec3 q = disc[j].position - cvert;
+				glm::vec3 du = dcvert + growth * q + dtheta * glm::cross(in.rotaxis, q);
+				glm::vec3 dj = radius * (R3 * in.sweeptangent[j]);
+				disc[j].normal = surfacenormal(du, dj, q);
 			}
+		}
 
-			diameter = (Spline1[i].position - Spline2[i].position);
-			scale = (1.f / height) * glm::length(diameter);
-			theta = glm::orientedAngle(glm::normalize(cam.getUp()), glm::normalize(diameter), -glm::normalize(cam.getPos()));
+		frame.center = cvert;
+		frame.dcenter = dcvert;
+		return frame;
+	}
 
-			if (temppinch1.verts.size() > 0 && temppinch2.verts.size() > 0) {
-				glm::vec3 P1 = closestvec(temppinch1.verts, cvert, cam.getUp());
-				glm::vec3 P2 = closestvec(temppinch2.verts, cvert, cam.getUp());
+	// The vertices closing the two ends of the surface
+	Vertex startcap(const RingFrame& frame) {
+		glm::vec3 normal = (glm::length(frame.daxis) > 0) ? glm::normalize(-frame.daxis) : glm::vec3(0.f);
+		return Vertex{ frame.axis, color, normal };
+	}
 
-				pdiameter = P2 - P1;
+	Vertex endcap(const RingFrame& frame) {
+		glm::vec3 normal = (glm::length(frame.dcenter) > 0) ? glm::normalize(frame.dcenter) : glm::vec3(0.f);
+		return Vertex{ frame.center, color, normal };
+	}
 
-				cvert = cvert * (glm::vec3(1.f) - glm::abs(glm::normalize(cam.getPos()))) + (0.5f * (P1 + P2) * glm::abs(glm::normalize(cam.getPos())));
+	// The rings are independent of each other, with a pool they are built in
+	// parallel straight into their place in verts
+	void create(int sprecision, ThreadPool* pool = nullptr) {
+		verts.clear();
+		axis.clear();
 
-				pscale = (1.f / width) * glm::length(pdiameter);
+		height = glm::distance(sweep.verts[0].position, sweep.verts[sweepindex(0.5f)].position);
+		width = glm::distance(sweep.verts[sweepindex(0.25f)].position, sweep.verts[sweepindex(0.75f)].position);
 
-				glm::vec3 scaleby = pscale * glm::abs(glm::normalize(cam.getPos())) + scale * (glm::vec3(1.f) - glm::abs(glm::normalize(cam.getPos())));
-			
-				glm::mat4 S = glm::scale(glm::mat4(1.f), scaleby);
-				glm::mat4 R = glm::rotate(glm::mat4(1.f), theta, -cam.getPos());
-				glm::mat4 T = glm::translate(glm::mat4(1.f), cvert);
+		RingInputs in;
+		sampleinputs(sprecision, in, pool);
 
-				disc.clear();
-				for (int j = 0; j < sweep.verts.size(); j++) {
-					glm::vec3 point = T * R * S * glm::vec4(sweep.verts[j].position, 1.f);
+		// index of the last ring, sprecision unless the tessellation is adaptive
+		int last = int(in.Spline1.size()) - 1;
+		size_t sweepsize = sweep.verts.size();
 
-					glm::vec3 normal = glm::vec3(0.f);
+		// start cap, the rings, end cap
+		verts.resize(2 + size_t(last + 1) * sweepsize);
+		axis.resize(last + 1);
+		std::vector<RingFrame> frames(last + 1);
 
-					verts.emplace_back(Vertex{ glm::vec4(point, 1.f), color, glm::vec3(0.f) });
-					disc.push_back(verts.back());
-				}
+		bool placed = placement != glm::mat4(1.f);
+		glm::mat3 rotation(placement);
 
-				discs.push_back(disc);
-			} else {
-				disc.clear();
-				disc = stdgetdisc(cvert, diameter, theta);
-				int k = 0;
-				for (auto j = disc.begin(); j < disc.end(); j++) {
-					verts.emplace_back((*j));
+		parallelFor(pool, 0, size_t(last) + 1, 4, [&](size_t begin, size_t end) {
+			std::vector<Vertex> disc;
+			for (size_t i = begin; i < end; i++) {
+				frames[i] = buildring(in, int(i), disc);
+				axis[i] = Vertex{ frames[i].axis, color, glm::vec3(0.f, 0.f, 0.f) };
+				if (placed) {
+					transformVertices(disc.data(), disc.size(), placement, rotation);
+					transformVertices(&axis[i], 1, placement);
 				}
-				discs.push_back(disc);
+				std::copy(disc.begin(), disc.end(), verts.begin() + 1 + i * sweepsize);
 			}
+		});
 
-			if (i == sprecision) {
-				glm::vec3 cvertprev = 0.5f * Spline1[i - 1].position + 0.5f * Spline2[i - 1].position;
-				verts.emplace_back(Vertex{ glm::vec4(cvert, 1.f), color, glm::normalize(cvert - cvertprev)});
-			}
+		verts.front() = startcap(frames.front());
+		verts.back() = endcap(frames.back());
+		if (placed) {
+			transformVertices(&verts.front(), 1, placement, rotation);
+			transformVertices(&verts.back(), 1, placement, rotation);
+		}
 
+		topology = Topology::of(SurfaceGrid{ int(sweepsize), last + 1 });
+
+		snapshot(sprecision, in);
+	}
+
+	// Inputs of the last create()/update(), to work out what an edit touched
+	struct BuildState {
+		int sprecision = -1;
+		Tessellation tess;
+		bool pinched = false;
+		bool reversed = false;
+		float theta = 0.f;
+		float phi = 0.f;
+		float radius = 0.f;
+		std::vector<glm::vec3> ctrl1;
+		std::vector<glm::vec3> ctrl2;
+		std::vector<glm::vec3> sweep;
+	};
+	BuildState built;
+
+	static std::vector<glm::vec3> positions(const std::vector<Vertex>& v) {
+		std::vector<glm::vec3> out;
+		out.reserve(v.size());
+		for (auto i = v.begin(); i < v.end(); i++) {
+			out.push_back((*i).position);
 		}
+		return out;
+	}
 
-		// NORMALS CALCULATION
-		float flipNormal = 1.0f;
-		
-		//glm::vec3 axisDir = axis[axis.size() - 1].position - axis[0].position;
-		//float sumOfComponents = axisDir.x + axisDir.y + axisDir.z;
-		//if (sumOfComponents < 0) {
-		//	flipNormal = -1.0f;
-		//}
-
-		glm::vec3 testnormal;
-		glm::vec3 realnormal;
-
-		glm::vec3 nextONring;
-		glm::vec3 nextring;
-		for (int i = 1; i < (verts.size()-1); i++) {
-			if (i % sweep.verts.size() == 0) {
-				if (i <= sweep.verts.size()) {
-					nextONring = glm::normalize(verts[i - (sweep.verts.size() - 1)].position - verts[i].position);
-					nextring = glm::normalize(verts[i + sweep.verts.size()].position - verts[i].position);
-				}
-				else {
-					nextONring = glm::normalize(verts[i - 1].position - verts[i].position);
-					nextring = glm::normalize(verts[i - sweep.verts.size()].position - verts[i].position);
-				}
+	void snapshot(int sprecision, const RingInputs& in) {
+		built.sprecision = sprecision;
+		built.tess = tess;
+		built.pinched = in.pinched;
+		built.reversed = linesreversed(ctrlpts1.verts, ctrlpts2.verts);
+		built.theta = cam.theta;
+		built.phi = cam.phi;
+		built.radius = cam.radius;
+		built.ctrl1 = positions(ctrlpts1.verts);
+		built.ctrl2 = positions(ctrlpts2.verts);
+		built.sweep = positions(sweep.verts);
+	}
+
+	// Rings [first, last) whose samples depend on control points that differ
+	// between before and after; empty if none do
+	static void changedrings(const std::vector<glm::vec3>& before, const std::vector<Vertex>& after, int sprecision, int& first, int& last) {
+		int m = int(after.size()) - 1;
+		first = sprecision + 1;
+		last = 0;
+		for (int i = 0; i <= m; i++) {
+			if (before[i] != after[i].position) {
+				int a;
+				int b;
+				uniformSamplesOf(3, m, sprecision, i, a, b);
+				first = std::min(first, a);
+				last = std::max(last, b);
 			}
-			else {
-				if (i <= sweep.verts.size()) {
-					nextONring = glm::normalize(verts[i + 1].position - verts[i].position);
-					nextring = glm::normalize(verts[i + sweep.verts.size()].position - verts[i].position);
-				}
-				else {
-					nextONring = glm::normalize(verts[i - 1].position - verts[i].position);
-					nextring = glm::normalize(verts[i - sweep.verts.size()].position - verts[i].position);
-				}
+		}
+	}
+
+	// True if update() can rebuild just the rings the moved control points
+	// reach: only boundary control points moved since the last build (same
+	// counts, sweep and settings), no pinch curves, uniform tessellation
+	bool incremental(int sprecision) {
+		bool pinched = pinch1.verts.size() > 0 && pinch2.verts.size() > 0;
+		return !verts.empty()
+			&& !pinched && !built.pinched
+			&& !tess.adaptive && !tess.arcLength
+			&& !built.tess.adaptive && !built.tess.arcLength
+			&& built.sprecision == sprecision
+			&& built.theta == cam.theta && built.phi == cam.phi && built.radius == cam.radius
+			&& built.ctrl1.size() == ctrlpts1.verts.size()
+			&& built.ctrl2.size() == ctrlpts2.verts.size()
+			&& built.sweep == positions(sweep.verts)
+			&& built.reversed == linesreversed(ctrlpts1.verts, ctrlpts2.verts);
+	}
+
+	// Regenerates the mesh after its control points changed. If incremental()
+	// just the rings the moved control points reach are rebuilt, and false is
+	// returned with the changed vertices in [first, first + count). Otherwise
+	// the whole mesh is rebuilt and true is returned.
+	bool update(int sprecision, size_t& first, size_t& count, ThreadPool* pool = nullptr) {
+		if (!incremental(sprecision)) {
+			create(sprecision, pool);
+			first = 0;
+			count = verts.size();
+			return true;
+		}
+
+		// the rings the moved control points reach, curve 2 runs backwards
+		// along the rings when the curves were drawn in opposite directions
+		int first1, last1, first2, last2;
+		changedrings(built.ctrl1, ctrlpts1.verts, sprecision, first1, last1);
+		changedrings(built.ctrl2, ctrlpts2.verts, sprecision, first2, last2);
+		if (built.reversed && first2 < last2) {
+			int flipped = sprecision + 1 - last2;
+			last2 = sprecision + 1 - first2;
+			first2 = flipped;
+		}
+		int firstring = std::min(first1, first2);
+		int lastring = std::max(last1, last2);
+
+		if (firstring >= lastring) {
+			first = 0;
+			count = 0;
+			return false;
+		}
+
+		RingInputs in;
+		sampleinputs(sprecision, in, pool);
+
+		int sweepsize = int(sweep.verts.size());
+		int lastindex = int(in.Spline1.size()) - 1;
+		std::vector<Vertex> disc;
+		for (int i = firstring; i < lastring; i++) {
+			RingFrame frame = buildring(in, i, disc);
+			axis[i] = Vertex{ frame.axis, color, glm::vec3(0.f, 0.f, 0.f) };
+			std::copy(disc.begin(), disc.end(), verts.begin() + 1 + size_t(i) * sweepsize);
+
+			if (i == 0) {
+				verts[0] = startcap(frame);
 			}
-			if (i == 1) {
-				testnormal = glm::normalize(glm::cross(nextONring, nextring));
-				realnormal = glm::normalize(verts[i].position - verts[0].position);
-				if (glm::length(testnormal + realnormal) < 1.f) {
-					flipNormal = -1.f;
-				}
+			if (i == lastindex) {
+				verts.back() = endcap(frame);
 			}
-			verts[i].normal = flipNormal * glm::normalize(glm::cross(nextONring, nextring));
-		}	
+		}
+
+		// the caps sit before the first and after the last ring
+		first = (firstring == 0) ? 0 : 1 + size_t(firstring) * sweepsize;
+		size_t end = (lastring == lastindex + 1) ? verts.size() : 1 + size_t(lastring) * sweepsize;
+		count = end - first;
+
+		snapshot(sprecision, in);
+		return false;
+	}
 
-		updateindices(indices, sweep.verts.size(), sprecision);
+	// uploads verts[first..first + count) only, after update()
+	void updateGPU(size_t first, size_t count) {
+		geometry.bind();
+		geometry.updateVerts(verts, first, count);
+		lod.invalidate();
+	}
+
+	// Index of the sweep vertex fraction of the way around it. Measured in
+	// length, so it doesn't depend on how the sweep was sampled.
+	size_t sweepindex(float fraction) const {
+		const std::vector<Vertex>& points = sweep.verts;
+		if (points.size() < 2) {
+			return 0;
+		}
 
-		temppinch1.verts.clear();
-		temppinch2.verts.clear();
+		std::vector<float> lengths(points.size(), 0.f);
+		for (size_t j = 1; j < points.size(); j++) {
+			lengths[j] = lengths[j - 1] + glm::distance(points[j - 1].position, points[j].position);
+		}
+
+		float target = fraction * lengths.back();
+		size_t j = std::lower_bound(lengths.begin(), lengths.end(), target) - lengths.begin();
+		if (j > 0 && (j == lengths.size() || target - lengths[j - 1] < lengths[j] - target)) {
+			j--;
+		}
+		return j;
 	}
 
-	std::vector<Line> getPinches(int sprecision) {
+	std::vector<Line> getPinches() {
 		std::vector<Line> output;
 		Line output1;
 		Line output2;
 
-		for (auto i = discs.begin(); i < discs.end(); i++){
-
-			std::vector<Vertex> disc = (*i);
-			if (crosssection.verts.size() > 0) {
-				output1.verts.push_back(disc[floor(1 * sprecision / 4)]);
-				output2.verts.push_back(disc[floor(3 * sprecision / 4)]);
-			}
-			else {
-				output1.verts.push_back(disc[0]);
-				output2.verts.push_back(disc[floor(sprecision / 2)]);
+		// the rings have as many vertices as the sweep, not the precision
+		int first = int((crosssection.verts.size() > 0) ? sweepindex(0.25f) : 0);
+		int second = int((crosssection.verts.size() > 0) ? sweepindex(0.75f) : sweepindex(0.5f));
+		if (topology) {
+			StridedView<Vertex> side1 = topology->grid().column(verts.data(), first);
+			StridedView<Vertex> side2 = topology->grid().column(verts.data(), second);
+			for (size_t i = 0; i < side1.size(); i++) {
+				output1.verts.push_back(side1[i]);
+				output2.verts.push_back(side2[i]);
 			}
 		}
 
@@ -390,7 +728,10 @@ public:
 		return output;
 	}
 
-	void setcrosssection(std::vector<Vertex> cross, glm::vec3 fixed, int precision) {
+	// The sweep is sampled independently of the rings: segments uniform
+	// samples, or with tess.adaptive as finely as its curvature needs (sharp
+	// turns keep their samples)
+	void setcrosssection(std::vector<Vertex> cross, glm::vec3 fixed, int segments, const Tessellation& tess) {
 		crosssection = cross;
 
 		Line temp;
@@ -398,9 +739,19 @@ public:
 		temp.MakeCrossSection(cam, fixed);
 		temp.MakeSweep(cam, fixed, getAxis());
 		cam.standardize(temp.verts);
-		temp.BSpline(precision, color);
 
-		sweep.verts = temp.verts;
+		if (tess.adaptive) {
+			std::vector<float> us;
+			int m = int(temp.verts.size()) - 1;
+			tessellateBSpline(temp.verts.data(), m, 3, tess, us);
+
+			sweep.verts.assign(us.size(), Vertex{ glm::vec3(0.f), color, glm::vec3(0.f) });
+			evalBSpline(temp.verts.data(), m, 3, us.data(), int(us.size()), sweep.verts.data());
+		}
+		else {
+			temp.BSpline(segments, color);
+			sweep.verts = temp.verts;
+		}
 	}
 
 	Line getCrosssection(glm::vec3 p1, glm::vec3 p2, glm::vec3 fixed) {
@@ -429,38 +780,73 @@ public:
 				output.verts.push_back(sweep.verts[i]);
 			}
 			cam.standardize(output.verts);
-			for (auto i = output.verts.begin(); i < output.verts.end(); i++) {
-				(*i).position = T1 * glm::inverse(S1) * R1 * glm::vec4((*i).position, 1.f);
-			}
+			transformVertices(output.verts.data(), output.verts.size(), T1 * glm::inverse(S1) * R1);
 			return output;
 		}
 	}
 	
 	void draw() {
+		if (!topology || verts.empty()) {
+			return;
+		}
 		geometry.bind();
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+		topology->draw();
 		glBindVertexArray(0);
 	}
 
+	// Draws LOD level (the default one is the full mesh), see LodChain
+	void draw(LodLevel level) {
+		if (level.full() || !topology || verts.empty() || !lod.draw(level, verts, topology->grid())) {
+			draw();
+		}
+	}
+
+	// Picks the level to draw at when the bounding sphere is screenRadius
+	// pixels on screen, keeping lodLevel in between frames
+	LodLevel chooselod(float screenRadius) {
+		lodLevel = topology ? lod.select(lodLevel, screenRadius, verts, topology->grid()) : LodLevel();
+		return lodLevel;
+	}
+
+	void boundingsphere(glm::vec3& center, float& radius) {
+		lod.bounds(verts, center, radius);
+	}
+
 	void updateGPU() {
 		geometry.bind();
 		geometry.setVerts(verts);
-		geometry.setIndices(indices);
+		lod.invalidate();
 	}
 
+	// The colour is a uniform set when drawing, nothing is uploaded
 	void setColor(glm::vec3 col) {
+		recolor(col);
+	}
+
+	void recolor(glm::vec3 col) {
 		color = col;
 
 		for (Vertex& v : verts) {
 			v.color = color;
 		}
+	}
 
-		updateGPU();
+	// Takes over the generated geometry of other (a copy of this mesh that was
+	// regenerated since), the GPU copy still has to be updated. The colour is
+	// kept, it may have been set after the copy was taken.
+	void adoptgeometry(Mesh& other) {
+		verts.swap(other.verts);
+		topology.swap(other.topology);
+		axis.swap(other.axis);
+		height = other.height;
+		width = other.width;
+		built = other.built;
+		recolor(color);
 	}
 
-	Mesh(std::vector<Vertex>& v, std::vector<unsigned int>& i, Camera& c)
+	Mesh(std::vector<Vertex>& v, const SurfaceGrid& grid, Camera& c)
 		: verts(v)
-		, indices(i)
+		, topology(Topology::of(grid))
 		, color(glm::vec3(0.f, 0.f, 0.f))
 		, ctrlpts1()
 		, ctrlpts2()
@@ -472,7 +858,7 @@ public:
 
 	Mesh()
 		: verts()
-		, indices()
+		, topology()
 		, color(glm::vec3(0.f, 0.f, 0.f))
 		, ctrlpts1()
 		, ctrlpts2()
@@ -0,0 +1,279 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// This file contains a queue for regenerating meshes on a background thread.
+// A job works on a copy of the mesh taken when it was submitted, so the
+// mesh itself keeps its old geometry (and keeps being drawn) until poll(),
+// on the GL thread, swaps the new CPU buffers in and uploads them. A newer
+// job for the same mesh supersedes the older ones: those still waiting are
+// skipped and a result that arrives late is dropped. Only the geometry is
+// swapped in, the mesh keeps whatever colour it has by then.
+//
+// A job can refine progressively: it is built at each of a list of
+// precisions in turn, and every level is swapped in as soon as it is ready.
+// plan() picks the levels from how long rings have taken to build so far, so
+// the first one fits in a frame.
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Mesh.h"
+
+class MeshJobs {
+public:
+
+	// Regenerates work at precision, returns true if all of it changed,
+	// otherwise the changed vertices are [first, first + count)
+	using Build = std::function<bool(Mesh& work, int precision, size_t& first, size_t& count)>;
+
+	MeshJobs()
+		: queue()
+		, done()
+		, current(nullptr)
+		, ringSeconds(1e-5)
+		, stopping(false)
+	{
+		worker = std::thread(&MeshJobs::run, this);
+	}
+
+	~MeshJobs() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		worker.join();
+	}
+
+	MeshJobs(const MeshJobs&) = delete;
+	MeshJobs& operator=(const MeshJobs&) = delete;
+
+	// Queues build on base, a copy of meshes[index] with its new inputs,
+	// at each of the precisions in levels
+	void submit(int index, Mesh base, Build build, std::vector<int> levels) {
+		std::shared_ptr<Job> job = std::make_shared<Job>();
+		job->index = index;
+		job->base = std::move(base);
+		job->build = std::move(build);
+		job->levels = std::move(levels);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			cancelJobs(index);
+			queue.push_back(job);
+		}
+		wake.notify_all();
+	}
+
+	// Drops every job for meshes[index], for when it is rebuilt right away
+	void cancel(int index) {
+		std::lock_guard<std::mutex> lock(mutex);
+		cancelJobs(index);
+	}
+
+	// Precisions to build a mesh of precision rings at: the first within
+	// budget seconds (at least minimum rings), then four times finer each
+	// step up to precision. Just precision if it fits in the budget itself.
+	std::vector<int> plan(int precision, double budget, int minimum = 8) {
+		double seconds;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			seconds = ringSeconds;
+		}
+
+		std::vector<int> levels;
+		double fits = budget / seconds;
+		int level = (fits >= precision) ? precision : std::min(precision, std::max(minimum, int(fits)));
+		while (level < precision) {
+			levels.push_back(level);
+			level *= 4;
+		}
+		levels.push_back(precision);
+		return levels;
+	}
+
+	// Reports a build of rings that took seconds, for plan()
+	void measured(int rings, double seconds) {
+		std::lock_guard<std::mutex> lock(mutex);
+		record(rings, seconds);
+	}
+
+	// Swaps finished levels into their meshes and uploads them. GL thread
+	// only, once per frame. Only the newest finished level of a job is used.
+	void poll(std::vector<Mesh>& meshes) {
+		std::deque<std::unique_ptr<Result>> finished;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& result : done) {
+				result->cancelled = result->job->cancelled;
+				result->index = result->job->index;
+			}
+			finished.swap(done);
+		}
+
+		// the results are destroyed here, on the GL thread, as their meshes
+		// get GPU geometry when swapped in
+		for (size_t i = 0; i < finished.size(); i++) {
+			Result& result = *finished[i];
+			bool newer = false;
+			for (size_t j = i + 1; j < finished.size(); j++) {
+				newer = newer || finished[j]->job == result.job;
+			}
+			if (newer || result.cancelled || result.index < 0 || result.index >= int(meshes.size())) {
+				continue;
+			}
+
+			// after an earlier level was swapped in the GPU copy no longer
+			// matches the base the partial update was made against
+			Mesh& mesh = meshes[result.index];
+			mesh.adoptgeometry(result.work);
+			if (result.full || result.job->adopted) {
+				mesh.updateGPU();
+			}
+			else if (result.count > 0) {
+				mesh.updateGPU(result.first, result.count);
+			}
+			result.job->adopted = true;
+		}
+	}
+
+	// Waits for every queued job and swaps them all in
+	void finish(std::vector<Mesh>& meshes) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			idle.wait(lock, [this] { return queue.empty() && current == nullptr; });
+		}
+		poll(meshes);
+	}
+
+	// meshes[index] was erased, the meshes after it moved down one
+	void erased(int index) {
+		std::lock_guard<std::mutex> lock(mutex);
+		cancelJobs(index);
+		forEach([index](Job& j) {
+			if (j.index > index) {
+				j.index--;
+			}
+		});
+	}
+
+private:
+	struct Job {
+		int index = -1;
+		bool cancelled = false;
+		Mesh base;
+		Build build;
+		std::vector<int> levels;
+
+		// a level was swapped in already (GL thread only)
+		bool adopted = false;
+	};
+
+	struct Result {
+		std::shared_ptr<Job> job;
+		Mesh work;
+		bool full = true;
+		size_t first = 0;
+		size_t count = 0;
+
+		// copied from the job under the lock by poll()
+		bool cancelled = false;
+		int index = -1;
+	};
+
+	// Calls f once for every job that is waiting, running or has results
+	// waiting for poll(). Call with mutex held.
+	void forEach(const std::function<void(Job&)>& f) {
+		std::vector<Job*> jobs;
+		for (auto& job : queue) jobs.push_back(job.get());
+		for (auto& result : done) jobs.push_back(result->job.get());
+		if (current != nullptr) jobs.push_back(current);
+
+		std::sort(jobs.begin(), jobs.end());
+		jobs.erase(std::unique(jobs.begin(), jobs.end()), jobs.end());
+		for (Job* job : jobs) f(*job);
+	}
+
+	void cancelJobs(int index) {
+		forEach([index](Job& j) {
+			if (j.index == index) {
+				j.cancelled = true;
+			}
+		});
+	}
+
+	void record(int rings, double seconds) {
+		if (rings > 0) {
+			ringSeconds = 0.5 * ringSeconds + 0.5 * (seconds / rings);
+		}
+	}
+
+	void run() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			wake.wait(lock, [this] { return stopping || !queue.empty(); });
+			if (stopping) {
+				return;
+			}
+
+			std::shared_ptr<Job> job = queue.front();
+			queue.pop_front();
+			current = job.get();
+
+			for (size_t level = 0; level < job->levels.size() && !job->cancelled && !stopping; level++) {
+				lock.unlock();
+
+				std::unique_ptr<Result> result = std::make_unique<Result>();
+				result->job = job;
+				result->work = job->base;
+
+				bool failed = false;
+				auto start = std::chrono::steady_clock::now();
+				try {
+					result->full = job->build(result->work, job->levels[level], result->first, result->count);
+				}
+				catch (...) {
+					failed = true;
+				}
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+				lock.lock();
+				if (failed) {
+					job->cancelled = true;
+				}
+				else if (result->full) {
+					record(job->levels[level], elapsed.count());
+				}
+				// poll() destroys it on the GL thread
+				done.push_back(std::move(result));
+			}
+
+			current = nullptr;
+			if (queue.empty()) {
+				idle.notify_all();
+			}
+		}
+	}
+
+	std::deque<std::shared_ptr<Job>> queue;
+	std::deque<std::unique_ptr<Result>> done;
+	Job* current;
+
+	// running estimate of the time one ring takes to build
+	double ringSeconds;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	bool stopping;
+
+	std::thread worker;
+};
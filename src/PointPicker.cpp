@@ -0,0 +1,126 @@
+#include "PointPicker.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool PickKey::operator==(const PickKey& other) const {
+	return points == other.points
+		&& count == other.count
+		&& revision == other.revision
+		&& theta == other.theta
+		&& phi == other.phi
+		&& radius == other.radius
+		&& screenWidth == other.screenWidth
+		&& screenHeight == other.screenHeight
+		&& cellSize == other.cellSize;
+}
+
+PointPicker::PointPicker()
+	: key()
+	, built(false)
+	, projected()
+	, origin(0.f)
+	, cell(1.f)
+	, cols(0)
+	, rows(0)
+	, cellStart()
+	, cellPoints()
+{}
+
+PointPicker::PointPicker(const PointPicker& other)
+	: PointPicker()
+{}
+
+PointPicker& PointPicker::operator=(const PointPicker& other) {
+	built = false;
+	return *this;
+}
+
+void PointPicker::update(const std::vector<Vertex>& points, const PickKey& newkey, Camera& cam) {
+	if (built && key == newkey) {
+		return;
+	}
+	key = newkey;
+	built = true;
+
+	// GL coordinates to screen coordinates, same as Callbacks3D::glPosToScreenCoords()
+	cam.getMousePos(points, projected);
+	glm::vec2 screen = glm::vec2(newkey.screenWidth, newkey.screenHeight);
+	for (auto p = projected.begin(); p < projected.end(); p++) {
+		glm::vec2 scaledZeroOne = 0.5f * ((*p) + glm::vec2(1.f, 1.f));
+		(*p) = glm::vec2(scaledZeroOne.x, 1.0f - scaledZeroOne.y) * screen;
+	}
+
+	cellStart.clear();
+	cellPoints.clear();
+	cols = 0;
+	rows = 0;
+	if (projected.empty()) {
+		return;
+	}
+
+	glm::vec2 low = projected[0];
+	glm::vec2 high = projected[0];
+	for (auto p = projected.begin(); p < projected.end(); p++) {
+		low = glm::min(low, (*p));
+		high = glm::max(high, (*p));
+	}
+
+	// points far off screen would make a huge grid, so the cells grow until
+	// there are at most a few per point
+	cell = std::max(newkey.cellSize, 1e-3f);
+	double maxCells = 4.0 * double(projected.size()) + 16.0;
+	double cells = (double(high.x - low.x) / cell + 1.0) * (double(high.y - low.y) / cell + 1.0);
+	if (cells > maxCells) {
+		cell *= float(std::sqrt(cells / maxCells));
+	}
+
+	origin = low;
+	cols = int((high.x - low.x) / cell) + 1;
+	rows = int((high.y - low.y) / cell) + 1;
+
+	// counting sort of the points into their cells
+	std::vector<int> cellOf(projected.size());
+	cellStart.assign(size_t(cols) * rows + 1, 0);
+	for (size_t i = 0; i < projected.size(); i++) {
+		int cx = std::min(int((projected[i].x - origin.x) / cell), cols - 1);
+		int cy = std::min(int((projected[i].y - origin.y) / cell), rows - 1);
+		cellOf[i] = cy * cols + cx;
+		cellStart[cellOf[i] + 1]++;
+	}
+	for (size_t c = 1; c < cellStart.size(); c++) {
+		cellStart[c] += cellStart[c - 1];
+	}
+
+	cellPoints.resize(projected.size());
+	std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+	for (size_t i = 0; i < projected.size(); i++) {
+		cellPoints[fill[cellOf[i]]++] = int(i);
+	}
+}
+
+int PointPicker::nearest(glm::vec2 pos, float radius) const {
+	if (cols == 0 || rows == 0) {
+		return -1;
+	}
+
+	int cx = int(std::floor((pos.x - origin.x) / cell));
+	int cy = int(std::floor((pos.y - origin.y) / cell));
+
+	int closest = -1;
+	float min = radius;
+	for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, rows - 1); y++) {
+		for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, cols - 1); x++) {
+			int c = y * cols + x;
+			for (int j = cellStart[c]; j < cellStart[c + 1]; j++) {
+				int i = cellPoints[j];
+				float distance = glm::length(projected[i] - pos);
+				if (distance < min || (distance == min && closest != -1 && i < closest)) {
+					min = distance;
+					closest = i;
+				}
+			}
+		}
+	}
+	return closest;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// This file contains a screen space index for picking control points with the
+// mouse. The points are projected once and bucketed into a uniform grid with
+// cells the size of the pick radius, so a query only looks at the 3x3 cells
+// around the cursor. The grid is rebuilt only when the points, the camera or
+// the window change.
+//------------------------------------------------------------------------------
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Geometry.h"
+#include "Camera.h"
+
+// Everything the projected grid depends on
+struct PickKey {
+	const Vertex* points;
+	size_t count;
+	unsigned int revision;	// bumped by whoever changes the points
+	float theta;
+	float phi;
+	float radius;
+	int screenWidth;
+	int screenHeight;
+	float cellSize;
+
+	bool operator==(const PickKey& other) const;
+};
+
+class PointPicker {
+public:
+
+	PointPicker();
+
+	// Copies start out unbuilt, like the GL objects of a copied line
+	PointPicker(const PointPicker& other);
+	PointPicker& operator=(const PointPicker& other);
+	PointPicker(PointPicker&& other) noexcept = default;
+	PointPicker& operator=(PointPicker&& other) noexcept = default;
+
+	// Rebuilds the grid from points unless it was already built for key.
+	void update(const std::vector<Vertex>& points, const PickKey& key, Camera& cam);
+
+	// Index of the point nearest to pos (screen coordinates) that is closer
+	// than radius, the lowest index on ties, or -1 if there is none. radius
+	// should not exceed the cell size.
+	int nearest(glm::vec2 pos, float radius) const;
+
+private:
+	PickKey key;
+	bool built;
+
+	std::vector<glm::vec2> projected;
+
+	glm::vec2 origin;
+	float cell;
+	int cols;
+	int rows;
+	// points of cell c are cellPoints[cellStart[c]..cellStart[c + 1])
+	std::vector<int> cellStart;
+	std::vector<int> cellPoints;
+};
@@ -0,0 +1,991 @@
+#include "Spline.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <utility>
+
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+
+std::vector <float> getbasis(int k, int m) {
+	std::vector <float> basis;
+	for (int i = 1; i <= 3; i++) {
+		if (i == 1) {
+			for (int j = 1; j <= k; j++) {
+				basis.push_back(0);
+			}
+		}
+		else if (i == 2) {
+			for (int j = 1; j < m - k + 2; j++) {
+				float inc = j / double(m - k + 2);
+				basis.push_back(inc);
+			}
+		}
+		else {
+			for (int j = 1; j <= k; j++) {
+				basis.push_back(1);
+			}
+		}
+	}
+	return basis;
+}
+
+// Number of floats in one span record of the SIMD kernels (see SplineBasis),
+// rounded up so 4 or 8 records can be transposed as whole registers.
+static int spanstride(int k) {
+	int fields = 3 * k + k * (k - 1);
+	return (fields + 7) / 8 * 8;
+}
+
+// Knot vector for one (k, m), plus a template of the per-span records the SIMD
+// kernels load. The record of knot span d holds everything de Boor's triangle
+// needs for a parameter in that span:
+//   [0, 3k)           x, y, z of the control points E[d - s], s = 0..k-1
+//                     (filled in per evaluation, zero in the template)
+//   [3k, 3k + 2 * p)  for each (r, s) step of the triangle, in the order it is
+//                     visited: U[i] and 1 / (U[i + r - 1] - U[i]) (0 if the
+//                     knots coincide), with i = d - s
+struct SplineBasis {
+	std::vector <float> U;
+	std::vector <float> records;
+	int stride;
+};
+
+static const SplineBasis& cachedsplinebasis(int k, int m) {
+	// std::map never moves its elements, so the returned reference stays valid
+	// after the lock is released
+	static std::map<std::pair<int, int>, SplineBasis> cache;
+	static std::mutex cacheMutex;
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	auto found = cache.find(std::make_pair(k, m));
+	if (found != cache.end()) {
+		return found->second;
+	}
+
+	SplineBasis basis;
+	basis.U = getbasis(k, m);
+	basis.stride = spanstride(k);
+	basis.records.assign(basis.stride * (m + 1), 0.f);
+
+	for (int d = k - 1; d <= m; d++) {
+		float* knots = basis.records.data() + d * basis.stride + 3 * k;
+		for (int r = k; r >= 2; r--) {
+			for (int s = 0; s <= r - 2; s++) {
+				int i = d - s;
+				float denom = basis.U[i + r - 1] - basis.U[i];
+				*knots++ = basis.U[i];
+				*knots++ = (denom != 0) ? 1.f / denom : 0.f;
+			}
+		}
+	}
+
+	return cache.emplace(std::make_pair(k, m), std::move(basis)).first->second;
+}
+
+const std::vector <float>& cachedbasis(int k, int m) {
+	return cachedsplinebasis(k, m).U;
+}
+
+int delta(const std::vector <float>& U, float u, int k, int m) {
+	for (int i = 0; i <= m + k - 1; i++) {
+		if (u >= U[i] && u < U[i + 1]) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+glm::vec3 getvert(const std::vector<Vertex>& E, const std::vector <float>& U, float u, int k, int m) {
+
+	float omega;
+	float denom;
+	int i;
+	int d = delta(U, u, k, m);
+
+	std::vector <glm::vec3> C(k);
+
+	if (d == -1) {
+		d = m;
+	}
+
+	for (i = 0; i <= k - 1; i++) {
+		C[i] = E[d - i].position;
+	}
+
+
+	for (int r = k; r >= 2; r--) {
+		i = d;
+		for (int s = 0; s <= r - 2; s++) {
+			denom = U[i + r - 1] - U[i];
+			if (denom != 0) {
+				omega = (u - U[i]) / denom;
+			}
+			else omega = 0;
+
+			C[s] = omega * C[s] + (1 - omega) * C[s + 1];
+			i = i - 1;
+		}
+	}
+
+	return C[0];
+}
+
+// Moves the knot span cursor d forward to the span containing u. Gives the same
+// span as delta(), including u = 1 landing on m.
+static int advancespan(const float* U, float u, int d, int k, int m) {
+	// parameters went backwards, start the walk over
+	if (u < U[d]) {
+		d = k - 1;
+	}
+	while (d < m && u >= U[d + 1]) {
+		d++;
+	}
+	return d;
+}
+
+// Same triangle as getvert(), with the scratch on the stack
+static glm::vec3 deboor(const Vertex* E, const float* U, float u, int d, int k) {
+	glm::vec3 C[MAX_SPLINE_ORDER];
+	float omega;
+	float denom;
+	int i;
+
+	for (i = 0; i <= k - 1; i++) {
+		C[i] = E[d - i].position;
+	}
+
+	for (int r = k; r >= 2; r--) {
+		i = d;
+		for (int s = 0; s <= r - 2; s++) {
+			denom = U[i + r - 1] - U[i];
+			if (denom != 0) {
+				omega = (u - U[i]) / denom;
+			}
+			else omega = 0;
+
+			C[s] = omega * C[s] + (1 - omega) * C[s + 1];
+			i = i - 1;
+		}
+	}
+
+	return C[0];
+}
+
+#if SIMD_X86
+// Span containing u without walking the knot vector. getbasis() spaces the
+// interior knots uniformly, so u * (number of spans) lands on the right span
+// up to rounding, which the two comparisons fix. Matches delta().
+static int spanof(const float* U, float u, int k, int m) {
+	int spans = m - k + 2;
+	if (spans < 1) {
+		return k - 1;
+	}
+
+	int j = int(u * float(spans));
+	if (j < 0) j = 0;
+	if (j > spans - 1) j = spans - 1;
+
+	int d = j + k - 1;
+	if (d > k - 1 && u < U[d]) {
+		d--;
+	}
+	else if (d < m && u >= U[d + 1]) {
+		d++;
+	}
+	return d;
+}
+
+// de Boor's triangle for 4 parameters at once. Lane l evaluates us[l] in knot
+// span d[l]: each lane loads its span record with plain vector loads, and a
+// 4x4 transpose turns the records into one register per field (structure of
+// arrays), so the triangle itself runs entirely in registers. omega comes
+// from a multiply by the cached reciprocal instead of a divide, which keeps
+// the result within 1e-6 of deboor().
+template <int K>
+static void deboorSSE(const float* records, const float* us, const int* d, Vertex* out) {
+	const int R = (3 * K + K * (K - 1) + 7) / 8 * 8;
+	__m128 f[R];
+
+	for (int b = 0; b < R; b += 4) {
+		__m128 r0 = _mm_loadu_ps(records + d[0] * R + b);
+		__m128 r1 = _mm_loadu_ps(records + d[1] * R + b);
+		__m128 r2 = _mm_loadu_ps(records + d[2] * R + b);
+		__m128 r3 = _mm_loadu_ps(records + d[3] * R + b);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		f[b] = r0;
+		f[b + 1] = r1;
+		f[b + 2] = r2;
+		f[b + 3] = r3;
+	}
+
+	__m128* Cx = f;
+	__m128* Cy = f + K;
+	__m128* Cz = f + 2 * K;
+	const __m128* knots = f + 3 * K;
+
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 u = _mm_loadu_ps(us);
+
+	for (int r = K; r >= 2; r--) {
+		for (int s = 0; s <= r - 2; s++) {
+			__m128 omega = _mm_mul_ps(_mm_sub_ps(u, knots[0]), knots[1]);
+			__m128 rest = _mm_sub_ps(one, omega);
+
+			Cx[s] = _mm_add_ps(_mm_mul_ps(omega, Cx[s]), _mm_mul_ps(rest, Cx[s + 1]));
+			Cy[s] = _mm_add_ps(_mm_mul_ps(omega, Cy[s]), _mm_mul_ps(rest, Cy[s + 1]));
+			Cz[s] = _mm_add_ps(_mm_mul_ps(omega, Cz[s]), _mm_mul_ps(rest, Cz[s + 1]));
+			knots += 2;
+		}
+	}
+
+	alignas(16) float x[4];
+	alignas(16) float y[4];
+	alignas(16) float z[4];
+	_mm_store_ps(x, Cx[0]);
+	_mm_store_ps(y, Cy[0]);
+	_mm_store_ps(z, Cz[0]);
+	for (int l = 0; l < 4; l++) {
+		out[l].position = glm::vec3(x[l], y[l], z[l]);
+	}
+}
+
+// 8x8 transpose of r[0..7]
+SIMD_TARGET_AVX2
+static inline void transpose8(__m256* r) {
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+	__m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+	__m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	__m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+	__m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+	__m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+	__m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+	r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// 8 wide version of deboorSSE().
+template <int K>
+SIMD_TARGET_AVX2
+static void deboorAVX2(const float* records, const float* us, const int* d, Vertex* out) {
+	const int R = (3 * K + K * (K - 1) + 7) / 8 * 8;
+	__m256 f[R];
+
+	for (int b = 0; b < R; b += 8) {
+		for (int l = 0; l < 8; l++) {
+			f[b + l] = _mm256_loadu_ps(records + d[l] * R + b);
+		}
+		transpose8(f + b);
+	}
+
+	__m256* Cx = f;
+	__m256* Cy = f + K;
+	__m256* Cz = f + 2 * K;
+	const __m256* knots = f + 3 * K;
+
+	const __m256 one = _mm256_set1_ps(1.f);
+	const __m256 u = _mm256_loadu_ps(us);
+
+	for (int r = K; r >= 2; r--) {
+		for (int s = 0; s <= r - 2; s++) {
+			__m256 omega = _mm256_mul_ps(_mm256_sub_ps(u, knots[0]), knots[1]);
+			__m256 rest = _mm256_sub_ps(one, omega);
+
+			Cx[s] = _mm256_add_ps(_mm256_mul_ps(omega, Cx[s]), _mm256_mul_ps(rest, Cx[s + 1]));
+			Cy[s] = _mm256_add_ps(_mm256_mul_ps(omega, Cy[s]), _mm256_mul_ps(rest, Cy[s + 1]));
+			Cz[s] = _mm256_add_ps(_mm256_mul_ps(omega, Cz[s]), _mm256_mul_ps(rest, Cz[s + 1]));
+			knots += 2;
+		}
+	}
+
+	alignas(32) float x[8];
+	alignas(32) float y[8];
+	alignas(32) float z[8];
+	_mm256_store_ps(x, Cx[0]);
+	_mm256_store_ps(y, Cy[0]);
+	_mm256_store_ps(z, Cz[0]);
+	for (int l = 0; l < 8; l++) {
+		out[l].position = glm::vec3(x[l], y[l], z[l]);
+	}
+}
+
+// Runs the whole batches of evalBSpline() through the SIMD kernel for order K
+// and returns how many parameters were evaluated. The span records are the
+// cached knot part with this curve's control points copied in; the copy is
+// per thread and reused, so it only allocates when curves grow.
+template <int K>
+static int evalSIMD(const Vertex* E, int m, const SplineBasis& basis, const float* us, int n, Vertex* out, CPU::SimdLevel level) {
+	int width = (level == CPU::SIMD_AVX2) ? 8 : 4;
+	if (n < width) {
+		return 0;
+	}
+
+	thread_local std::vector<float> records;
+	records.assign(basis.records.begin(), basis.records.end());
+	for (int d = K - 1; d <= m; d++) {
+		float* rec = records.data() + d * basis.stride;
+		for (int s = 0; s < K; s++) {
+			rec[s] = E[d - s].position.x;
+			rec[K + s] = E[d - s].position.y;
+			rec[2 * K + s] = E[d - s].position.z;
+		}
+	}
+
+	const float* U = basis.U.data();
+	int spans[8];
+	int i = 0;
+	for (; i + width <= n; i += width) {
+		for (int l = 0; l < width; l++) {
+			spans[l] = spanof(U, us[i + l], K, m);
+		}
+		if (level == CPU::SIMD_AVX2) {
+			deboorAVX2<K>(records.data(), us + i, spans, out + i);
+		}
+		else {
+			deboorSSE<K>(records.data(), us + i, spans, out + i);
+		}
+	}
+	return i;
+}
+#endif
+
+void evalBSpline(const Vertex* E, int m, int k, const float* us, int n, Vertex* out) {
+	const SplineBasis& basis = cachedsplinebasis(k, m);
+	const std::vector <float>& U = basis.U;
+
+	if (k > MAX_SPLINE_ORDER) {
+		std::vector<Vertex> ctrl(E, E + m + 1);
+		for (int i = 0; i < n; i++) {
+			out[i].position = getvert(ctrl, U, us[i], k, m);
+		}
+		return;
+	}
+
+	int i = 0;
+
+#if SIMD_X86
+	CPU::SimdLevel level = CPU::simdLevel();
+	if (level != CPU::SIMD_SCALAR) {
+		switch (k) {
+		case 2: i = evalSIMD<2>(E, m, basis, us, n, out, level); break;
+		case 3: i = evalSIMD<3>(E, m, basis, us, n, out, level); break;
+		case 4: i = evalSIMD<4>(E, m, basis, us, n, out, level); break;
+		case 5: i = evalSIMD<5>(E, m, basis, us, n, out, level); break;
+		default: break;
+		}
+	}
+#endif
+
+	int d = k - 1;
+	// scalar path, and the leftovers that do not fill a whole SIMD batch
+	for (; i < n; i++) {
+		d = advancespan(U.data(), us[i], d, k, m);
+		out[i].position = deboor(E, U.data(), us[i], d, k);
+	}
+}
+
+// Uniform B-Spline basis matrices. On a span whose surrounding knots are evenly
+// spaced the curve is the polynomial sum_i t^i * sum_j M[i][j] * P_j, with t the
+// local parameter in [0, 1) and P_0..P_{K-1} the K control points of the span.
+template <int K>
+struct UniformBasis;
+
+template <>
+struct UniformBasis<3> {
+	static constexpr float M[3][3] = {
+		{ 0.5f, 0.5f, 0.f },
+		{ -1.f, 1.f, 0.f },
+		{ 0.5f, -1.f, 0.5f }
+	};
+};
+
+template <>
+struct UniformBasis<4> {
+	static constexpr float M[4][4] = {
+		{ 1.f / 6.f, 4.f / 6.f, 1.f / 6.f, 0.f },
+		{ -3.f / 6.f, 0.f, 3.f / 6.f, 0.f },
+		{ 3.f / 6.f, -6.f / 6.f, 3.f / 6.f, 0.f },
+		{ -1.f / 6.f, 3.f / 6.f, -3.f / 6.f, 1.f / 6.f }
+	};
+};
+
+// Evaluates samples first..first + count - 1 of knot interval j (span d),
+// sample i at local parameter i * dt - j. The span's power basis coefficients are formed once from the
+// basis matrix, after which every sample is a K - 1 step Horner evaluation.
+// (Forward differencing was tried as well: reseeding its difference table often
+// enough to keep float drift under control cost more than it saved.)
+template <int K>
+static void evalUniformSpan(const Vertex* E, int d, int j, int first, float dt, int count, Vertex* out) {
+	const auto& M = UniformBasis<K>::M;
+
+	glm::vec3 a[K];
+	for (int i = 0; i < K; i++) {
+		a[i] = glm::vec3(0.f);
+		for (int j = 0; j < K; j++) {
+			a[i] += M[i][j] * E[d - K + 1 + j].position;
+		}
+	}
+
+	// t from the sample's own index, so a sample comes out the same whichever
+	// range it is evaluated in
+	for (int n = 0; n < count; n++) {
+		float t = float(first + n) * dt - float(j);
+		glm::vec3 point = a[K - 1];
+		for (int i = K - 2; i >= 0; i--) {
+			point = point * t + a[i];
+		}
+		out[n].position = point;
+	}
+}
+
+// Samples [begin, end) of the uniform sampling that fall in knot interval j,
+// i.e. with floor(i * spans / precision) == j (the last one also takes u = 1).
+static void spansamples(int j, int spans, int precision, int& begin, int& end) {
+	begin = (j * precision + spans - 1) / spans;
+	end = (j == spans - 1) ? precision + 1 : ((j + 1) * precision + spans - 1) / spans;
+}
+
+// Uniform sampling for order K. Sample i sits at x = i * spans / precision
+// knot intervals from the start, so its span and local parameter follow from
+// integer arithmetic without looking at the knot vector (a sample exactly on a
+// knot may land in either neighbouring span, both give the same point). The
+// spans next to the clamped ends see the repeated knots, so only spans
+// 2K-3..m-K+2 have a uniform neighbourhood and take the basis matrix path;
+// the rest fall back to de Boor. Results stay within 1e-4 of getvert(),
+// relative to the size of the control polygon.
+// Only samples first..last-1 are written, out still points at sample 0.
+template <int K>
+static void evalUniformMatrix(const Vertex* E, int m, int precision, int first, int last, Vertex* out) {
+	const std::vector <float>& U = cachedbasis(K, m);
+
+	int spans = m - K + 2;
+	float dt = float(spans) / float(precision);
+
+	for (int j = 0; j < spans; j++) {
+		int begin;
+		int end;
+		spansamples(j, spans, precision, begin, end);
+		begin = std::max(begin, first);
+		end = std::min(end, last);
+		if (end <= begin) {
+			continue;
+		}
+
+		int d = j + K - 1;
+		if (d >= 2 * K - 3 && d <= m - K + 2) {
+			evalUniformSpan<K>(E, d, j, begin, dt, end - begin, out + begin);
+		}
+		else {
+			for (int i = begin; i < end; i++) {
+				out[i].position = deboor(E, U.data(), float(double(i) / precision), d, K);
+			}
+		}
+	}
+}
+
+void evalBSplineUniform(const Vertex* E, int m, int k, int precision, Vertex* out) {
+	evalBSplineUniformRange(E, m, k, precision, 0, precision + 1, out);
+}
+
+void evalBSplineUniformRange(const Vertex* E, int m, int k, int precision, int first, int last, Vertex* out) {
+	if (k == 3) {
+		evalUniformMatrix<3>(E, m, precision, first, last, out);
+		return;
+	}
+	if (k == 4) {
+		evalUniformMatrix<4>(E, m, precision, first, last, out);
+		return;
+	}
+
+	if (last <= first) {
+		return;
+	}
+
+	thread_local std::vector<float> us;
+	us.resize(last - first);
+	for (int i = first; i < last; i++) {
+		us[i - first] = float(double(i) / precision);
+	}
+
+	evalBSpline(E, m, k, us.data(), last - first, out + first);
+}
+
+void derivativecontrolpoints(const Vertex* E, int m, int k, std::vector<Vertex>& Q) {
+	const std::vector <float>& U = cachedbasis(k, m);
+
+	Q.assign(std::max(m, 0), Vertex{ glm::vec3(0.f), glm::vec3(0.f), glm::vec3(0.f) });
+	for (int i = 0; i < m; i++) {
+		float denom = U[i + k] - U[i + 1];
+		if (denom != 0) {
+			Q[i].position = (float(k - 1) / denom) * (E[i + 1].position - E[i].position);
+		}
+	}
+}
+
+// Evaluates the derivative curves and copies their positions out. evaluate
+// runs one of the batched evaluators on (control points, m, k, output).
+template <typename Evaluate>
+static void evalderivatives(const Vertex* E, int m, int k, int n, glm::vec3* d1, glm::vec3* d2, Evaluate evaluate) {
+	thread_local std::vector<Vertex> Q1;
+	thread_local std::vector<Vertex> Q2;
+	thread_local std::vector<Vertex> out;
+	out.resize(n);
+
+	bool first = (k >= 2 && m >= 1);
+	bool second = (k >= 3 && m >= 2);
+
+	if (first) {
+		derivativecontrolpoints(E, m, k, Q1);
+	}
+	if (d1) {
+		if (first) {
+			evaluate(Q1.data(), m - 1, k - 1, out.data());
+			for (int i = 0; i < n; i++) d1[i] = out[i].position;
+		}
+		else {
+			std::fill(d1, d1 + n, glm::vec3(0.f));
+		}
+	}
+	if (d2) {
+		if (second) {
+			derivativecontrolpoints(Q1.data(), m - 1, k - 1, Q2);
+			evaluate(Q2.data(), m - 2, k - 2, out.data());
+			for (int i = 0; i < n; i++) d2[i] = out[i].position;
+		}
+		else {
+			std::fill(d2, d2 + n, glm::vec3(0.f));
+		}
+	}
+}
+
+void evalBSplineDerivatives(const Vertex* E, int m, int k, const float* us, int n, glm::vec3* d1, glm::vec3* d2) {
+	evalderivatives(E, m, k, n, d1, d2, [us, n](const Vertex* Q, int mq, int kq, Vertex* out) {
+		evalBSpline(Q, mq, kq, us, n, out);
+	});
+}
+
+void evalBSplineUniformDerivatives(const Vertex* E, int m, int k, int precision, glm::vec3* d1, glm::vec3* d2) {
+	evalderivatives(E, m, k, precision + 1, d1, d2, [precision](const Vertex* Q, int mq, int kq, Vertex* out) {
+		evalBSplineUniform(Q, mq, kq, precision, out);
+	});
+}
+
+void uniformSamplesOf(int k, int m, int precision, int index, int& first, int& last) {
+	// control point index is used by the spans d = index..index + k - 1,
+	// knot interval j = d - k + 1
+	int spans = m - k + 2;
+	int j0 = std::max(index - k + 1, 0);
+	int j1 = std::min(index, spans - 1);
+
+	int unused;
+	spansamples(j0, spans, precision, first, unused);
+	spansamples(j1, spans, precision, unused, last);
+}
+
+// An interval of the adaptive tessellation with its midpoint already
+// evaluated, ordered by how far it is out of tolerance.
+struct TessInterval {
+	float a;
+	float b;
+	glm::vec3 pa;
+	glm::vec3 pb;
+	glm::vec3 pm;
+	float error;
+
+	bool operator<(const TessInterval& other) const { return error < other.error; }
+};
+
+static glm::vec3 evalpoint(const Vertex* E, int m, int k, float u) {
+	Vertex v;
+	evalBSpline(E, m, k, &u, 1, &v);
+	return v.position;
+}
+
+static TessInterval makeinterval(const Vertex* E, int m, int k, const Tessellation& tess, float a, float b, glm::vec3 pa, glm::vec3 pb) {
+	TessInterval I{ a, b, pa, pb, glm::vec3(0.f), 0.f };
+	I.pm = evalpoint(E, m, k, 0.5f * (a + b));
+
+	// distance from the midpoint to the chord
+	glm::vec3 chord = pb - pa;
+	float len2 = glm::dot(chord, chord);
+	float chorderror = glm::length(I.pm - pa);
+	if (len2 > 0) {
+		float t = glm::clamp(glm::dot(I.pm - pa, chord) / len2, 0.f, 1.f);
+		chorderror = glm::length(I.pm - (pa + t * chord));
+	}
+
+	// turn between the two halves
+	float angleerror = 0.f;
+	glm::vec3 first = I.pm - pa;
+	glm::vec3 second = pb - I.pm;
+	if (glm::length(first) > 0 && glm::length(second) > 0) {
+		float c = glm::clamp(glm::dot(glm::normalize(first), glm::normalize(second)), -1.f, 1.f);
+		angleerror = std::acos(c);
+	}
+
+	if (tess.chordTolerance > 0) I.error = std::max(I.error, chorderror / tess.chordTolerance);
+	if (tess.angleTolerance > 0) I.error = std::max(I.error, angleerror / tess.angleTolerance);
+	return I;
+}
+
+void tessellateBSpline(const Vertex* E, int m, int k, const Tessellation& tess, std::vector <float>& us) {
+	const std::vector <float>& U = cachedbasis(k, m);
+
+	// seeds: uniform samples plus every distinct knot, so each polynomial
+	// piece is looked at at least once
+	us.clear();
+	int seeds = std::max(tess.minSamples, 2);
+	for (int i = 0; i < seeds; i++) {
+		us.push_back(float(double(i) / (seeds - 1)));
+	}
+	for (int i = k; i <= m; i++) {
+		us.push_back(U[i]);
+	}
+	std::sort(us.begin(), us.end());
+	us.erase(std::unique(us.begin(), us.end()), us.end());
+
+	std::vector<Vertex> seedpoints(us.size());
+	evalBSpline(E, m, k, us.data(), int(us.size()), seedpoints.data());
+
+	std::priority_queue<TessInterval> open;
+	for (size_t i = 0; i + 1 < us.size(); i++) {
+		open.push(makeinterval(E, m, k, tess, us[i], us[i + 1], seedpoints[i].position, seedpoints[i + 1].position));
+	}
+
+	int samples = int(us.size());
+	while (!open.empty() && open.top().error > 1.f && samples < tess.maxSamples) {
+		TessInterval I = open.top();
+		open.pop();
+
+		float mid = 0.5f * (I.a + I.b);
+		if (mid <= I.a || mid >= I.b) {
+			continue; // out of float resolution
+		}
+
+		us.push_back(mid);
+		samples++;
+		open.push(makeinterval(E, m, k, tess, I.a, mid, I.pa, I.pm));
+		open.push(makeinterval(E, m, k, tess, mid, I.b, I.pm, I.pb));
+	}
+
+	std::sort(us.begin(), us.end());
+}
+
+int circleSegments(const Tessellation& tess, int segments) {
+	if (!tess.adaptive) {
+		return segments;
+	}
+
+	// a chord of angle a is 1 - cos(a / 2) away from the arc, and turns by a
+	const double pi = 3.14159265358979323846;
+	double chordAngle = 2.0 * std::acos(std::max(-1.0, 1.0 - double(tess.chordTolerance)));
+	double angle = std::min(chordAngle, double(tess.angleTolerance));
+	int count = (angle > 0.0) ? int(std::ceil(2.0 * pi / angle)) : tess.maxSamples;
+	return std::min(std::max(count, std::max(tess.minSamples, 3)), std::max(tess.maxSamples, 3));
+}
+
+void mergeparameters(const std::vector <float>& a, const std::vector <float>& b, std::vector <float>& out, float epsilon) {
+	out.clear();
+	out.reserve(a.size() + b.size());
+
+	size_t i = 0;
+	size_t j = 0;
+	while (i < a.size() || j < b.size()) {
+		float next;
+		if (j >= b.size() || (i < a.size() && a[i] <= b[j])) {
+			next = a[i++];
+		}
+		else {
+			next = b[j++];
+		}
+		if (out.empty() || next - out.back() > epsilon) {
+			out.push_back(next);
+		}
+	}
+}
+
+// Values of the k basis functions that are nonzero on span d at u, for control
+// points d - k + 1 .. d (Cox-de Boor triangle)
+static void basisfunctions(const float* U, float u, int d, int k, float* N) {
+	float left[MAX_SPLINE_ORDER];
+	float right[MAX_SPLINE_ORDER];
+
+	N[0] = 1.f;
+	for (int j = 1; j < k; j++) {
+		left[j] = u - U[d + 1 - j];
+		right[j] = U[d + j] - u;
+		float saved = 0.f;
+		for (int r = 0; r < j; r++) {
+			float denom = right[r + 1] + left[j - r];
+			float temp = (denom != 0.f) ? N[r] / denom : 0.f;
+			N[r] = saved + right[r + 1] * temp;
+			saved = left[j - r] * temp;
+		}
+		N[j] = saved;
+	}
+}
+
+// Symmetric positive definite band matrix, row i keeps the entries (i, i - j)
+// for j = 0..band
+struct BandMatrix {
+	int n;
+	int band;
+	std::vector<double> a;
+
+	BandMatrix(int n, int band) : n(n), band(band), a(size_t(n) * (band + 1), 0.0) {}
+
+	// lower triangle only, i >= j
+	double& at(int i, int j) { return a[size_t(i) * (band + 1) + (i - j)]; }
+
+	// in place Cholesky, false if the matrix is not positive definite
+	bool factor() {
+		for (int i = 0; i < n; i++) {
+			for (int j = std::max(0, i - band); j <= i; j++) {
+				double sum = at(i, j);
+				for (int l = std::max(0, i - band); l < j; l++) {
+					sum -= at(i, l) * at(j, l);
+				}
+				if (i == j) {
+					if (sum <= 0.0) return false;
+					at(i, i) = std::sqrt(sum);
+				}
+				else {
+					at(i, j) = sum / at(j, j);
+				}
+			}
+		}
+		return true;
+	}
+
+	// solves L L^T x = b after factor()
+	void solve(std::vector<glm::dvec3>& b) {
+		for (int i = 0; i < n; i++) {
+			for (int l = std::max(0, i - band); l < i; l++) {
+				b[i] -= at(i, l) * b[l];
+			}
+			b[i] /= at(i, i);
+		}
+		for (int i = n - 1; i >= 0; i--) {
+			for (int l = i + 1; l <= std::min(n - 1, i + band); l++) {
+				b[i] -= at(l, i) * b[l];
+			}
+			b[i] /= at(i, i);
+		}
+	}
+};
+
+// Fit with exactly m + 1 control points, returns the max parametric error
+static float fitwithcount(const std::vector<glm::vec3>& points, const std::vector<float>& ts, int k, int m, std::vector<glm::vec3>& ctrl) {
+	const std::vector<float>& U = cachedbasis(k, m);
+	int n = m - 1;	// unknowns: the interior control points
+
+	ctrl.assign(m + 1, glm::vec3(0.f));
+	ctrl[0] = points.front();
+	ctrl[m] = points.back();
+
+	if (n > 0) {
+		int band = std::max(k - 1, 2);
+		BandMatrix A(n, band);
+		std::vector<glm::dvec3> b(n, glm::dvec3(0.0));
+
+		float N[MAX_SPLINE_ORDER];
+		int d = k - 1;
+		for (size_t p = 0; p < points.size(); p++) {
+			d = advancespan(U.data(), ts[p], d, k, m);
+			basisfunctions(U.data(), ts[p], d, k, N);
+
+			// move the fixed end points to the right hand side
+			glm::dvec3 r = glm::dvec3(points[p]);
+			for (int a = 0; a < k; a++) {
+				int i = d - k + 1 + a;
+				if (i == 0 || i == m) r -= double(N[a]) * glm::dvec3(ctrl[i]);
+			}
+
+			for (int a = 0; a < k; a++) {
+				int i = d - k + 1 + a;
+				if (i == 0 || i == m) continue;
+				b[i - 1] += double(N[a]) * r;
+				for (int c = 0; c <= a; c++) {
+					int j = d - k + 1 + c;
+					if (j == 0 || j == m) continue;
+					A.at(i - 1, j - 1) += double(N[a]) * N[c];
+				}
+			}
+		}
+
+		// a light second difference penalty keeps spans without data (and the
+		// system) well behaved
+		double lambda = 1e-4 * double(points.size()) / (m + 1);
+		const double w[3] = { 1.0, -2.0, 1.0 };
+		for (int c = 1; c < m; c++) {
+			for (int a = 0; a < 3; a++) {
+				int i = c - 1 + a;
+				if (i == 0 || i == m) continue;
+				for (int e = 0; e < 3; e++) {
+					int j = c - 1 + e;
+					if (j == 0 || j == m) {
+						b[i - 1] -= lambda * w[a] * w[e] * glm::dvec3(ctrl[j]);
+					}
+					else if (j <= i) {
+						A.at(i - 1, j - 1) += lambda * w[a] * w[e];
+					}
+				}
+			}
+		}
+
+		if (A.factor()) {
+			A.solve(b);
+			for (int i = 1; i < m; i++) {
+				ctrl[i] = glm::vec3(b[i - 1]);
+			}
+		}
+	}
+
+	// max distance of the data from the curve at its parameter
+	std::vector<Vertex> E(m + 1);
+	for (int i = 0; i <= m; i++) {
+		E[i].position = ctrl[i];
+	}
+	std::vector<Vertex> fitted(points.size());
+	evalBSpline(E.data(), m, k, ts.data(), int(ts.size()), fitted.data());
+
+	float error = 0.f;
+	for (size_t p = 0; p < points.size(); p++) {
+		error = std::max(error, glm::distance(points[p], fitted[p].position));
+	}
+	return error;
+}
+
+float fitBSpline(const std::vector<glm::vec3>& points, int k, float tolerance, int maxControlPoints, std::vector<glm::vec3>& ctrl) {
+	int count = int(points.size());
+	if (count < k) {
+		ctrl = points;
+		return 0.f;
+	}
+
+	// chord length parameters
+	std::vector<float> ts(count, 0.f);
+	double total = 0.0;
+	for (int i = 1; i < count; i++) {
+		total += glm::distance(points[i - 1], points[i]);
+		ts[i] = float(total);
+	}
+	for (int i = 1; i < count; i++) {
+		ts[i] = (total > 0.0) ? float(ts[i] / total) : float(i) / float(count - 1);
+	}
+	ts.back() = 1.f;
+
+	int most = std::max(k, std::min(maxControlPoints, count));
+	if (tolerance <= 0.f) {
+		return fitwithcount(points, ts, k, most - 1, ctrl);
+	}
+
+	// grow the control point count until the fit is within tolerance, then
+	// bisect for the smallest count that still is
+	int low = k - 1;	// known to fail (or below the minimum)
+	int high = k;
+	std::vector<glm::vec3> best;
+	float besterror = fitwithcount(points, ts, k, high - 1, best);
+	while (besterror > tolerance && high < most) {
+		low = high;
+		high = std::min(2 * high, most);
+		besterror = fitwithcount(points, ts, k, high - 1, best);
+	}
+
+	std::vector<glm::vec3> trial;
+	while (besterror <= tolerance && high - low > 1) {
+		int mid = (low + high) / 2;
+		float error = fitwithcount(points, ts, k, mid - 1, trial);
+		if (error <= tolerance) {
+			high = mid;
+			best.swap(trial);
+			besterror = error;
+		}
+		else {
+			low = mid;
+		}
+	}
+
+	ctrl.swap(best);
+	return besterror;
+}
+
+void ArcLengthTable::build(const Vertex* E, int m, int k, int samplesPerSpan) {
+	int spans = m - k + 2;
+	int count = std::max(spans, 1) * std::max(samplesPerSpan, 1) + 1;
+
+	us.resize(count);
+	for (int i = 0; i < count; i++) {
+		us[i] = float(double(i) / (count - 1));
+	}
+
+	std::vector<Vertex> points(count);
+	evalBSpline(E, m, k, us.data(), count, points.data());
+
+	lengths.resize(count);
+	lengths[0] = 0.f;
+	for (int i = 1; i < count; i++) {
+		lengths[i] = lengths[i - 1] + glm::distance(points[i - 1].position, points[i].position);
+	}
+}
+
+// u at arc length s inside table interval [i, i + 1]
+static float interpolateparam(const std::vector<float>& us, const std::vector<float>& lengths, size_t i, float s) {
+	float ds = lengths[i + 1] - lengths[i];
+	float t = (ds > 0.f) ? (s - lengths[i]) / ds : 0.f;
+	return us[i] + glm::clamp(t, 0.f, 1.f) * (us[i + 1] - us[i]);
+}
+
+float ArcLengthTable::param(float s) const {
+	if (us.size() < 2 || s <= 0.f) return 0.f;
+	if (s >= length()) return 1.f;
+
+	size_t i = std::upper_bound(lengths.begin(), lengths.end(), s) - lengths.begin() - 1;
+	return interpolateparam(us, lengths, i, s);
+}
+
+void ArcLengthTable::params(int count, std::vector<float>& out) const {
+	out.resize(std::max(count, 0));
+	if (count <= 0) return;
+	if (count == 1 || us.size() < 2) {
+		for (int i = 0; i < count; i++) {
+			out[i] = (count == 1) ? 0.f : float(double(i) / (count - 1));
+		}
+		return;
+	}
+
+	float total = length();
+	size_t j = 0;
+	for (int i = 0; i < count; i++) {
+		float s = total * float(double(i) / (count - 1));
+		while (j + 2 < lengths.size() && lengths[j + 1] < s) {
+			j++;
+		}
+		out[i] = interpolateparam(us, lengths, j, s);
+	}
+	out[0] = 0.f;
+	out[count - 1] = 1.f;
+}
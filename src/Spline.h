@@ -0,0 +1,127 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// This file contains the B-Spline evaluation routines used by Line and Mesh.
+// getvert() evaluates a single parameter value, the evalBSpline() family
+// evaluates a whole batch of them against one control polygon without any
+// per-sample allocation.
+//------------------------------------------------------------------------------
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Geometry.h"
+
+// Highest order the batched evaluators handle with their fixed size scratch.
+const int MAX_SPLINE_ORDER = 8;
+
+// How a curve is turned into samples. Uniform tessellation takes precision + 1
+// evenly spaced parameters (or evenly spaced in arc length); adaptive
+// tessellation subdivides until the polyline is within the error bounds,
+// between minSamples and maxSamples samples.
+struct Tessellation {
+	bool adaptive = false;
+	bool arcLength = false;			// uniform in arc length instead of parameter (non adaptive only)
+	float chordTolerance = 0.002f;		// max distance from the curve to the polyline
+	float angleTolerance = 0.0873f;		// max turn between consecutive segments (radians)
+	int minSamples = 8;
+	int maxSamples = 300;
+};
+
+// Standard (clamped, uniform interior) knot vector for order k and control points 0..m
+std::vector <float> getbasis(int k, int m);
+
+// Same knot vector as getbasis(k, m), built once per (k, m) and then reused.
+// Safe to call from several threads.
+const std::vector <float>& cachedbasis(int k, int m);
+
+// Algorithm to find delta (from A2 and Lecture)
+int delta(const std::vector <float>& U, float u, int k, int m);
+
+// Efficient algorithm to find a value of the B-Spline at a given u value (from A2 and Lecture)
+glm::vec3 getvert(const std::vector<Vertex>& E, const std::vector <float>& U, float u, int k, int m);
+
+// Evaluates the order k B-Spline with control points E[0..m] at the n parameter
+// values in us and writes the positions into out[0..n-1]. Only the position of
+// each output vertex is touched. Parameters are expected in non-decreasing
+// order so the knot span can be tracked with a running cursor.
+//
+// On x86-64 the parameters are evaluated 4 (SSE) or 8 (AVX2) at a time, picked
+// at runtime through CPU::simdLevel(). The SIMD kernels multiply by cached
+// reciprocal knot differences instead of dividing, so their results agree with
+// getvert() to within 1e-6 relative to the size of the control polygon.
+void evalBSpline(const Vertex* E, int m, int k, const float* us, int n, Vertex* out);
+
+// Evaluates the precision + 1 uniformly spaced parameters u = i / precision.
+// Orders 3 and 4 evaluate the interior spans from the uniform basis matrix
+// (within 1e-4 of getvert(), relative to the size of the control polygon);
+// other orders go through evalBSpline().
+void evalBSplineUniform(const Vertex* E, int m, int k, int precision, Vertex* out);
+
+// Same samples as evalBSplineUniform(), but only writes out[first..last-1].
+// Gives the same values the full evaluation would.
+void evalBSplineUniformRange(const Vertex* E, int m, int k, int precision, int first, int last, Vertex* out);
+
+// Control points of the derivative d/du of the order k curve with control
+// points E[0..m]: an order k - 1 curve with control points Q[0..m-1], whose
+// knot vector is again getbasis(k - 1, m - 1).
+void derivativecontrolpoints(const Vertex* E, int m, int k, std::vector<Vertex>& Q);
+
+// First and second derivatives d/du, d2/du2 at the n parameters in us (same
+// requirements as evalBSpline()). Either output may be null.
+void evalBSplineDerivatives(const Vertex* E, int m, int k, const float* us, int n, glm::vec3* d1, glm::vec3* d2);
+
+// Derivatives at the precision + 1 parameters of evalBSplineUniform().
+void evalBSplineUniformDerivatives(const Vertex* E, int m, int k, int precision, glm::vec3* d1, glm::vec3* d2);
+
+// Samples [first, last) of evalBSplineUniform() that control point index has
+// any influence on (the knot spans it supports).
+void uniformSamplesOf(int k, int m, int precision, int index, int& first, int& last);
+
+// Chooses parameters for the curve according to tess.adaptive == true. Starts
+// from minSamples uniform parameters plus the knots, then keeps splitting the
+// interval with the largest error (distance of its midpoint from the chord, or
+// the turn at the midpoint) until every interval is within tolerance or
+// maxSamples is reached. The result is sorted and includes 0 and 1.
+void tessellateBSpline(const Vertex* E, int m, int k, const Tessellation& tess, std::vector <float>& us);
+
+// Number of segments a circle of radius 1 is split into: segments as given
+// without tess.adaptive, otherwise the fewest equal ones within tess' chord
+// and angle tolerances (clamped to minSamples..maxSamples).
+int circleSegments(const Tessellation& tess, int segments);
+
+// Sorted union of two sorted parameter lists, dropping values closer than
+// epsilon to the previous one.
+void mergeparameters(const std::vector <float>& a, const std::vector <float>& b, std::vector <float>& out, float epsilon = 1e-6f);
+
+// Least squares fit of an order k B-Spline, with the knot vector getbasis(k, m),
+// to a stroke (chord length parameters, end points interpolated). Picks the
+// fewest control points, at most maxControlPoints, that keep every stroke point
+// within tolerance of the curve; tolerance <= 0 uses exactly maxControlPoints.
+// Returns the max error of the fit.
+float fitBSpline(const std::vector<glm::vec3>& points, int k, float tolerance, int maxControlPoints, std::vector<glm::vec3>& ctrl);
+
+// Cumulative arc length of a curve at densely sampled parameters, for
+// converting between arc length and parameter.
+class ArcLengthTable {
+public:
+
+	// Samples the order k curve with control points E[0..m], samplesPerSpan
+	// samples for every knot span.
+	void build(const Vertex* E, int m, int k, int samplesPerSpan = 16);
+
+	bool empty() const { return us.empty(); }
+	float length() const { return empty() ? 0.f : lengths.back(); }
+
+	// Parameter at arc length s (clamped to the curve).
+	float param(float s) const;
+
+	// count parameters evenly spaced in arc length, from 0 to 1 included. One
+	// monotone walk over the table.
+	void params(int count, std::vector<float>& out) const;
+
+private:
+	std::vector<float> us;
+	std::vector<float> lengths;
+};
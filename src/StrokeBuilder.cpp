@@ -0,0 +1,109 @@
+#include "StrokeBuilder.h"
+
+#include <algorithm>
+
+StrokeBuilder::StrokeBuilder(float spacing, float tolerance, int maxWindow)
+	: spacing(spacing)
+	, tolerance(tolerance)
+	, maxWindow(maxWindow)
+	, simplified()
+	, window()
+	, last(0.f)
+	, samples(0)
+{}
+
+void StrokeBuilder::begin(glm::vec3 p) {
+	simplified.clear();
+	window.clear();
+	simplified.push_back(p);
+	last = p;
+	samples = 1;
+}
+
+size_t StrokeBuilder::add(glm::vec3 p) {
+	size_t first = simplified.size();
+
+	// step from the last resampled point towards the cursor
+	glm::vec3 start = last;
+	glm::vec3 slope = p - start;
+	float pointDistance = glm::length(slope);
+	if (pointDistance < spacing) {
+		return first;
+	}
+	slope = slope / pointDistance;
+
+	for (float dist = spacing; dist <= pointDistance; dist += spacing) {
+		last = start + slope * dist;
+		first = std::min(first, push(last));
+	}
+	return first;
+}
+
+bool StrokeBuilder::fits(glm::vec3 anchor, glm::vec3 p) const {
+	glm::vec3 d = p - anchor;
+	float len2 = glm::dot(d, d);
+
+	for (size_t i = 0; i + 1 < window.size(); i++) {
+		glm::vec3 closest = anchor;
+		if (len2 > 0) {
+			float t = glm::clamp(glm::dot(window[i] - anchor, d) / len2, 0.f, 1.f);
+			closest = anchor + t * d;
+		}
+		if (glm::distance(window[i], closest) > tolerance) {
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t StrokeBuilder::push(glm::vec3 p) {
+	samples++;
+
+	if (simplified.size() == 1) {
+		simplified.push_back(p);
+		window.assign(1, p);
+		return 1;
+	}
+
+	glm::vec3 anchor = simplified[simplified.size() - 2];
+	window.push_back(p);
+
+	// the latest sample slides along while the stroke is still straight enough
+	if (int(window.size()) <= maxWindow && fits(anchor, p)) {
+		simplified.back() = p;
+		return simplified.size() - 1;
+	}
+
+	// otherwise the previous sample (already the last point) is kept
+	simplified.push_back(p);
+	window.assign(1, p);
+	return simplified.size() - 1;
+}
+
+void StrokeBuilder::resample(std::vector<glm::vec3>& out) const {
+	out.clear();
+	if (simplified.empty()) {
+		return;
+	}
+
+	out.push_back(simplified[0]);
+	float carry = 0.f;	// arc length since the last output point
+	for (size_t i = 0; i + 1 < simplified.size(); i++) {
+		glm::vec3 a = simplified[i];
+		glm::vec3 d = simplified[i + 1] - a;
+		float len = glm::length(d);
+		if (len <= 0.f) {
+			continue;
+		}
+
+		float dist = spacing - carry;
+		for (; dist <= len; dist += spacing) {
+			out.push_back(a + d * (dist / len));
+		}
+		carry = len - (dist - spacing);
+	}
+
+	if (carry > 0.5f * spacing) {
+		out.push_back(simplified.back());
+	}
+}
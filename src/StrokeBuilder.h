@@ -0,0 +1,54 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// This file contains the online stroke ingester used while the user draws.
+// Mouse samples are resampled every `spacing` units of arc length and then
+// simplified as they arrive: a point is only kept once the stroke can no longer
+// be replaced by a straight segment within `tolerance`. The work per sample is
+// bounded by the window size, so long strokes cost the same per frame as short
+// ones.
+//------------------------------------------------------------------------------
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class StrokeBuilder {
+public:
+
+	StrokeBuilder(float spacing, float tolerance, int maxWindow = 64);
+
+	// Starts a new stroke at p, dropping the previous one.
+	void begin(glm::vec3 p);
+
+	// Adds a mouse sample. Returns the index of the first point of points()
+	// that changed, everything before it is as it was before the call.
+	size_t add(glm::vec3 p);
+
+	// Simplified stroke: the kept points followed by the latest sample.
+	const std::vector<glm::vec3>& points() const { return simplified; }
+
+	// Number of resampled points the stroke would have had without simplification.
+	int sampleCount() const { return samples; }
+
+	// Resamples the simplified stroke every `spacing` units, for the curve fit
+	// at the end of the stroke.
+	void resample(std::vector<glm::vec3>& out) const;
+
+	float spacing;
+	float tolerance;
+	int maxWindow;
+
+private:
+	// true if every point of the window is within tolerance of anchor-p
+	bool fits(glm::vec3 anchor, glm::vec3 p) const;
+
+	// feeds one resampled point to the simplifier, returns the first changed index
+	size_t push(glm::vec3 p);
+
+	std::vector<glm::vec3> simplified;
+	// resampled points since the last kept point
+	std::vector<glm::vec3> window;
+	glm::vec3 last;
+	int samples;
+};
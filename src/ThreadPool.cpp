@@ -0,0 +1,237 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+// the pool and queue of the worker running on this thread, if any
+static thread_local ThreadPool* currentPool = nullptr;
+static thread_local size_t currentIndex = 0;
+
+
+TaskGroup::TaskGroup(ThreadPool* pool)
+	: pool(pool)
+	, pending(0)
+	, errorMutex()
+	, error()
+{}
+
+TaskGroup::~TaskGroup() {
+	// don't leave tasks pointing at a dead group, errors are dropped here
+	try {
+		wait();
+	}
+	catch (...) {
+	}
+}
+
+void TaskGroup::run(std::function<void()> task) {
+	if (pool == nullptr || pool->threads() == 1) {
+		try {
+			task();
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if (!error) {
+				error = std::current_exception();
+			}
+		}
+		return;
+	}
+
+	pending++;
+	pool->push(ThreadPool::Task{ std::move(task), this });
+}
+
+void TaskGroup::wait() {
+	if (pool != nullptr) {
+		size_t self = (currentPool == pool) ? currentIndex : pool->queues.size() - 1;
+		while (pending.load() > 0) {
+			if (!pool->tryRun(self)) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	std::exception_ptr rethrow;
+	{
+		std::lock_guard<std::mutex> lock(errorMutex);
+		std::swap(rethrow, error);
+	}
+	if (rethrow) {
+		std::rethrow_exception(rethrow);
+	}
+}
+
+void TaskGroup::finish(std::exception_ptr taskError) {
+	if (taskError) {
+		std::lock_guard<std::mutex> lock(errorMutex);
+		if (!error) {
+			error = taskError;
+		}
+	}
+	pending--;
+}
+
+
+ThreadPool::ThreadPool(unsigned int threads)
+	: workers()
+	, queues()
+	, sleepMutex()
+	, wake()
+	, queued(0)
+	, stopping(false)
+{
+	start(threads);
+}
+
+ThreadPool::~ThreadPool() {
+	stop();
+}
+
+unsigned int ThreadPool::hardwareThreads() {
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+void ThreadPool::resize(unsigned int threads) {
+	stop();
+	// tasks still queued run here, their groups would wait for them forever
+	// once the queues are replaced
+	while (tryRun(queues.size() - 1)) {
+	}
+	start(threads);
+}
+
+void ThreadPool::start(unsigned int threads) {
+	if (threads == 0) {
+		threads = hardwareThreads();
+	}
+
+	stopping = false;
+	queues.clear();
+	for (unsigned int i = 0; i < threads; i++) {
+		queues.push_back(std::make_unique<Queue>());
+	}
+	for (unsigned int i = 0; i + 1 < threads; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this, size_t(i));
+	}
+}
+
+void ThreadPool::stop() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+}
+
+void ThreadPool::push(Task task) {
+	// workers keep their own tasks (they are the most likely to be in cache),
+	// everyone else shares the last queue
+	size_t index = (currentPool == this) ? currentIndex : queues.size() - 1;
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+		queues[index]->tasks.push_back(std::move(task));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		queued++;
+	}
+	wake.notify_one();
+}
+
+bool ThreadPool::tryRun(size_t self) {
+	Task task;
+	bool found = false;
+
+	// newest task of our own queue first, then the oldest of the others
+	{
+		std::lock_guard<std::mutex> lock(queues[self]->mutex);
+		if (!queues[self]->tasks.empty()) {
+			task = std::move(queues[self]->tasks.back());
+			queues[self]->tasks.pop_back();
+			found = true;
+		}
+	}
+	for (size_t i = 1; !found && i < queues.size(); i++) {
+		Queue& victim = *queues[(self + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			found = true;
+		}
+	}
+
+	if (!found) {
+		return false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		queued--;
+	}
+
+	std::exception_ptr error;
+	try {
+		task.work();
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+	task.group->finish(error);
+	return true;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+	currentPool = this;
+	currentIndex = index;
+
+	while (true) {
+		if (tryRun(index)) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+		if (stopping) {
+			return;
+		}
+	}
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body) {
+	if (end <= begin) {
+		return;
+	}
+
+	// a few chunks per thread so a slow one can be balanced by stealing
+	size_t count = end - begin;
+	grain = std::max(grain, size_t(1));
+	size_t chunks = std::min((count + grain - 1) / grain, size_t(4) * threads());
+	if (chunks <= 1 || threads() == 1) {
+		body(begin, end);
+		return;
+	}
+
+	size_t size = (count + chunks - 1) / chunks;
+	TaskGroup group(this);
+	for (size_t first = begin; first < end; first += size) {
+		size_t last = std::min(first + size, end);
+		group.run([&body, first, last] { body(first, last); });
+	}
+	group.wait();
+}
+
+void parallelFor(ThreadPool* pool, size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body) {
+	if (pool == nullptr) {
+		if (begin < end) {
+			body(begin, end);
+		}
+		return;
+	}
+	pool->parallelFor(begin, end, grain, body);
+}
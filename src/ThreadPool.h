@@ -0,0 +1,109 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// This file contains a small work stealing thread pool. Every worker has its
+// own task deque: it pops new work from the back of its own and, when that is
+// empty, steals the oldest task from the front of another. A thread waiting on
+// a TaskGroup runs queued tasks instead of blocking, so groups can be nested
+// (a task can itself call parallelFor()) without deadlocking the pool.
+//
+// parallelFor() splits a range into chunks that only depend on the range, the
+// grain and the thread count, never on timing, so kernels that write their
+// results by index give the same output on any run.
+//------------------------------------------------------------------------------
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool;
+
+// A set of tasks that can be waited for together
+class TaskGroup {
+public:
+
+	// With a null pool the tasks run right away on the calling thread.
+	TaskGroup(ThreadPool* pool);
+	~TaskGroup();
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	void run(std::function<void()> task);
+
+	// Runs queued tasks until every task of the group finished. Rethrows the
+	// first exception one of them threw.
+	void wait();
+
+private:
+	friend class ThreadPool;
+
+	void finish(std::exception_ptr error);
+
+	ThreadPool* pool;
+	std::atomic<int> pending;
+	std::mutex errorMutex;
+	std::exception_ptr error;
+};
+
+class ThreadPool {
+public:
+
+	// threads counts the thread calling wait() too, so a pool of n threads
+	// starts n - 1 workers. 0 uses every hardware thread.
+	ThreadPool(unsigned int threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned int threads() const { return unsigned(workers.size()) + 1; }
+
+	// Stops the workers, runs whatever is still queued on the calling thread
+	// and starts threads - 1 new ones. Must not be called from a task or while
+	// another thread is adding tasks.
+	void resize(unsigned int threads);
+
+	// Calls body(first, last) on chunks covering [begin, end), at least grain
+	// indices each (except the last), and returns when all of them are done.
+	void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+	static unsigned int hardwareThreads();
+
+private:
+	friend class TaskGroup;
+
+	struct Task {
+		std::function<void()> work;
+		TaskGroup* group;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void start(unsigned int threads);
+	void stop();
+	void push(Task task);
+	bool tryRun(size_t self);
+	void workerLoop(size_t index);
+
+	std::vector<std::thread> workers;
+	// one per worker plus a last one that threads outside the pool push to
+	std::vector<std::unique_ptr<Queue>> queues;
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> queued;
+	bool stopping;
+};
+
+// pool->parallelFor() or, without a pool, body(begin, end) on this thread
+void parallelFor(ThreadPool* pool, size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body);
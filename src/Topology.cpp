@@ -0,0 +1,185 @@
+#include "Topology.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+
+
+int SurfaceGrid::face(size_t f, size_t corners[4]) const {
+	int n = segments;
+	int s = int(f % n);
+
+	// start cap
+	if (f < size_t(n)) {
+		corners[0] = vertex(0, s + 1);
+		corners[1] = startcap();
+		corners[2] = vertex(0, s);
+		return 3;
+	}
+
+	// end cap
+	int band = int(f / n) - 1;
+	if (band == rings - 1) {
+		corners[0] = vertex(rings - 1, s);
+		corners[1] = endcap();
+		corners[2] = vertex(rings - 1, s + 1);
+		return 3;
+	}
+
+	corners[0] = vertex(band, s + 1);
+	corners[1] = vertex(band, s);
+	corners[2] = vertex(band + 1, s);
+	corners[3] = vertex(band + 1, s + 1);
+	return 4;
+}
+
+
+// Appends a grid as strips: the start cap, the bands between the rings in
+// columns width segments wide, then the end cap. A column goes down every
+// band before the next one starts, so the ring a band shares with the one
+// before it is still in the vertex cache. With width = segments this is the
+// plain ring by ring order.
+static void appendStrips(const SurfaceGrid& grid, int width, unsigned int restart, std::vector<unsigned int>& strips) {
+	int n = grid.segments;
+
+	// A fan as a strip: ring vertices alternating with the centre, every
+	// other triangle is degenerate. The start cap goes around backwards to
+	// keep the winding.
+	for (int s = n; s > 0; s--) {
+		strips.push_back(unsigned(grid.vertex(0, s)));
+		strips.push_back(unsigned(grid.startcap()));
+	}
+	strips.push_back(unsigned(grid.vertex(0, 0)));
+	strips.push_back(restart);
+
+	for (int first = 0; first < n; first += width) {
+		int last = std::min(first + width, n);
+		for (int j = 0; j + 1 < grid.rings; j++) {
+			for (int s = first; s <= last; s++) {
+				strips.push_back(unsigned(grid.vertex(j, s)));
+				strips.push_back(unsigned(grid.vertex(j + 1, s)));
+			}
+			strips.push_back(restart);
+		}
+	}
+
+	for (int s = 0; s < n; s++) {
+		strips.push_back(unsigned(grid.vertex(grid.rings - 1, s)));
+		strips.push_back(unsigned(grid.endcap()));
+	}
+	strips.push_back(unsigned(grid.vertex(grid.rings - 1, n)));
+}
+
+
+Topology::Topology(const SurfaceGrid& grid)
+	: layout(grid)
+	, strips()
+	, indexType(GL_UNSIGNED_INT)
+	, restart(0xFFFFFFFFu)
+	, ringOrder()
+	, cacheOrder()
+	, buffer()
+{
+	// the restart index can't be a vertex
+	if (grid.vertexCount() < 0xFFFF) {
+		indexType = GL_UNSIGNED_SHORT;
+		restart = 0xFFFF;
+	}
+
+	int n = grid.segments;
+	if (grid.rings <= 0 || n <= 0) {
+		return;
+	}
+
+	// The first band of a column transforms both of its rings, 2 * (width + 1)
+	// vertices, and the lower ring has to stay cached through that for the
+	// next band. After that every band adds only its lower ring.
+	int width = std::max(1, std::min(n, (vertexCacheSize - 1) / 2));
+
+	appendStrips(grid, n, restart, strips);
+	ringOrder = simulateStrips(strips, restart);
+	cacheOrder = ringOrder;
+
+	// small rings fit the cache in plain order already, and columns only add
+	// restarts to them
+	std::vector<unsigned int> columns;
+	appendStrips(grid, width, restart, columns);
+	CacheStats columnOrder = simulateStrips(columns, restart);
+	if (columnOrder.transforms < ringOrder.transforms) {
+		strips.swap(columns);
+		cacheOrder = columnOrder;
+	}
+}
+
+
+Topology::~Topology() = default;
+
+
+// Like the geometry pool the cache is never freed, the buffers still in it at
+// exit go with the GL context
+static std::mutex cacheMutex;
+
+static std::map<std::pair<int, int>, std::shared_ptr<const Topology>>& cache() {
+	static auto* topologies = new std::map<std::pair<int, int>, std::shared_ptr<const Topology>>();
+	return *topologies;
+}
+
+
+std::shared_ptr<const Topology> Topology::of(const SurfaceGrid& grid) {
+	std::pair<int, int> key(grid.segments, grid.rings);
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		auto found = cache().find(key);
+		if (found != cache().end()) {
+			return found->second;
+		}
+	}
+
+	// built outside the lock, if another thread got there first its copy wins
+	auto topology = std::make_shared<const Topology>(grid);
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return cache().emplace(key, std::move(topology)).first->second;
+}
+
+
+void Topology::trim() {
+	// a count of one is the cache itself, and nobody can take a new reference
+	// without the lock, so this drops the last one
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	for (auto i = cache().begin(); i != cache().end();) {
+		if (i->second.use_count() == 1) {
+			i = cache().erase(i);
+		}
+		else {
+			i++;
+		}
+	}
+}
+
+
+void Topology::draw() const {
+	if (strips.empty()) {
+		return;
+	}
+
+	if (!buffer) {
+		buffer = std::make_unique<ElementBuffer>();
+		if (indexType == GL_UNSIGNED_SHORT) {
+			std::vector<uint16_t> shorts(strips.begin(), strips.end());
+			buffer->uploadData(sizeof(uint16_t) * shorts.size(), shorts.data(), GL_STATIC_DRAW);
+		}
+		else {
+			buffer->uploadData(sizeof(unsigned int) * strips.size(), strips.data(), GL_STATIC_DRAW);
+		}
+	}
+
+	// binding it while the vertex array is bound attaches it to that array
+	buffer->bind();
+	glEnable(GL_PRIMITIVE_RESTART);
+	glPrimitiveRestartIndex(restart);
+	glDrawElements(GL_TRIANGLE_STRIP, GLsizei(strips.size()), indexType, 0);
+	glDisable(GL_PRIMITIVE_RESTART);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// This file contains the connectivity of the generated surfaces. A rotational
+// surface is a grid: rings of the same number of vertices, one after the
+// other, between a cap vertex at each end. Which vertices make up a face
+// follows from (ring, segment) alone, so meshes store just their vertices
+// and a SurfaceGrid saying how they are laid out.
+//
+// For drawing, every grid of the same size shares one Topology: the grid as
+// triangle strips (across the bands between two rings, and around each cap,
+// split by primitive restart) in a single element buffer. Indices are
+// uploaded as 16 bit when the grid is small enough for them. The bands are
+// drawn in columns sized to the post-transform vertex cache, so most
+// vertices are transformed once rather than once per band they touch.
+//------------------------------------------------------------------------------
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "ElementBuffer.h"
+#include "VertexCache.h"
+
+// count elements stride apart, a ring or a column of a grid's vertices
+// without copying them. Only valid while the array it points into is.
+template <typename T>
+class StridedView {
+public:
+	StridedView(T* first, size_t count, size_t stride)
+		: first(first)
+		, count(count)
+		, stride(stride)
+	{}
+
+	T& operator[](size_t i) const { return first[i * stride]; }
+	size_t size() const { return count; }
+
+private:
+	T* first;
+	size_t count;
+	size_t stride;
+};
+
+// Layout of a grid surface's vertices: the start cap, rings * segments ring
+// vertices ring by ring, then the end cap
+struct SurfaceGrid {
+	int segments = 0;
+	int rings = 0;
+
+	size_t vertexCount() const { return (rings > 0) ? 2 + size_t(rings) * segments : 0; }
+	size_t startcap() const { return 0; }
+	size_t endcap() const { return vertexCount() - 1; }
+	// segment wraps around the ring
+	size_t vertex(int ring, int segment) const { return 1 + size_t(ring) * segments + size_t(segment % segments); }
+
+	// The vertices of one ring, and of one segment across all rings, in
+	// verts laid out like this grid
+	template <typename T>
+	StridedView<T> ring(T* verts, int r) const { return StridedView<T>(verts + vertex(r, 0), size_t(segments), 1); }
+	template <typename T>
+	StridedView<T> column(T* verts, int s) const { return StridedView<T>(verts + vertex(0, s), size_t(rings), size_t(segments)); }
+
+	// The start cap's triangles, a quad per segment of every band between
+	// two rings, then the end cap's triangles
+	size_t faceCount() const { return (rings > 0) ? size_t(rings + 1) * segments : 0; }
+	// Writes the vertices of face f to corners and returns their number, 3
+	// or 4. Faces wind the same way as the strips.
+	int face(size_t f, size_t corners[4]) const;
+
+	bool operator==(const SurfaceGrid& other) const { return segments == other.segments && rings == other.rings; }
+	bool operator!=(const SurfaceGrid& other) const { return !(*this == other); }
+};
+
+class Topology {
+public:
+
+	explicit Topology(const SurfaceGrid& grid);
+	~Topology();
+
+	Topology(const Topology&) = delete;
+	Topology& operator=(const Topology&) = delete;
+
+	// The shared topology of grids of this size. Thread safe.
+	static std::shared_ptr<const Topology> of(const SurfaceGrid& grid);
+
+	// Drops the cached topologies no mesh uses anymore, which deletes their
+	// element buffers. GL thread only.
+	static void trim();
+
+	const SurfaceGrid& grid() const { return layout; }
+
+	// Simulated vertex cache use of the strips drawn, and of the plain ring by
+	// ring order (the two are the same where that was better)
+	const CacheStats& cacheStats() const { return cacheOrder; }
+	const CacheStats& ringOrderStats() const { return ringOrder; }
+
+	// Draws the grid from the bound vertex array, uploading the element
+	// buffer the first time. GL thread only.
+	void draw() const;
+
+private:
+	SurfaceGrid layout;
+
+	// the strips, restart separated
+	std::vector<unsigned int> strips;
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, what the element buffer holds
+	GLenum indexType;
+	unsigned int restart;
+
+	CacheStats ringOrder;
+	CacheStats cacheOrder;
+
+	// created on first draw(), so topologies can be made on any thread
+	mutable std::unique_ptr<ElementBuffer> buffer;
+};
@@ -0,0 +1,200 @@
+#include "Transform.h"
+#include "CpuFeatures.h"
+
+#include <cstddef>
+
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+
+// The upper three rows of an affine transform, row major. Normals use a
+// zero translation column.
+struct AffineRows {
+	float m[3][4];
+};
+
+static AffineRows rowsof(const glm::mat4& M) {
+	AffineRows A;
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 4; c++) {
+			A.m[r][c] = M[c][r];
+		}
+	}
+	return A;
+}
+
+static AffineRows rowsof(const glm::mat3& N) {
+	AffineRows A;
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 3; c++) {
+			A.m[r][c] = N[c][r];
+		}
+		A.m[r][3] = 0.f;
+	}
+	return A;
+}
+
+static inline glm::vec3 apply(const AffineRows& A, const glm::vec3& p) {
+	return glm::vec3(
+		A.m[0][0] * p.x + A.m[0][1] * p.y + A.m[0][2] * p.z + A.m[0][3],
+		A.m[1][0] * p.x + A.m[1][1] * p.y + A.m[1][2] * p.z + A.m[1][3],
+		A.m[2][0] * p.x + A.m[2][1] * p.y + A.m[2][2] * p.z + A.m[2][3]);
+}
+
+// verts[first..n-1], and the leftovers that do not fill a whole SIMD batch
+template <bool Normals>
+static void transformScalar(Vertex* verts, size_t first, size_t n, const AffineRows& P, const AffineRows& N) {
+	for (size_t i = first; i < n; i++) {
+		verts[i].position = apply(P, verts[i].position);
+		if (Normals) {
+			verts[i].normal = apply(N, verts[i].normal);
+		}
+	}
+}
+
+#if SIMD_X86
+// Vertex is 9 floats. A batch reads 4 floats per vertex for each field
+// (position plus the float after it, the float before the normal plus the
+// normal, so nothing past the last vertex is touched) and transposes them
+// into one register per coordinate, structure of arrays. The matrix entries
+// are broadcast once per call; the extra lane goes back unchanged.
+static_assert(sizeof(Vertex) == 9 * sizeof(float), "transform kernels expect a packed Vertex");
+const int positionFloat = int(offsetof(Vertex, position) / sizeof(float));
+const int normalFloat = int(offsetof(Vertex, normal) / sizeof(float)) - 1;
+
+// r[c..c+2] = A * r[c..c+2] in every lane
+static inline void applySSE(__m128* r, int c, const __m128 (*a)[4]) {
+	__m128 o[3];
+	for (int k = 0; k < 3; k++) {
+		o[k] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[k][0], r[c]), _mm_mul_ps(a[k][1], r[c + 1])), _mm_add_ps(_mm_mul_ps(a[k][2], r[c + 2]), a[k][3]));
+	}
+	r[c] = o[0];
+	r[c + 1] = o[1];
+	r[c + 2] = o[2];
+}
+
+static inline void fieldSSE(float* first, int offset, int c, const __m128 (*a)[4]) {
+	__m128 r[4];
+	for (int l = 0; l < 4; l++) {
+		r[l] = _mm_loadu_ps(first + 9 * l + offset);
+	}
+	_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+	applySSE(r, c, a);
+	_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+	for (int l = 0; l < 4; l++) {
+		_mm_storeu_ps(first + 9 * l + offset, r[l]);
+	}
+}
+
+template <bool Normals>
+static size_t transformSSE(Vertex* verts, size_t n, const AffineRows& P, const AffineRows& N) {
+	__m128 p[3][4];
+	__m128 q[3][4];
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 4; c++) {
+			p[r][c] = _mm_set1_ps(P.m[r][c]);
+			q[r][c] = _mm_set1_ps(N.m[r][c]);
+		}
+	}
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		float* first = reinterpret_cast<float*>(verts + i);
+		fieldSSE(first, positionFloat, 0, p);
+		if (Normals) {
+			fieldSSE(first, normalFloat, 1, q);
+		}
+	}
+	return i;
+}
+
+// _MM_TRANSPOSE4_PS within each 128 bit half
+SIMD_TARGET_AVX2
+static inline void transpose4x2(__m256* r) {
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+	__m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+	__m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	r[0] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	r[1] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	r[2] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	r[3] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+// 8 wide fieldSSE(), vertex l in the low half and l + 4 in the high half
+SIMD_TARGET_AVX2
+static inline void fieldAVX2(float* first, int offset, int c, const __m256 (*a)[4]) {
+	__m256 r[4];
+	for (int l = 0; l < 4; l++) {
+		__m128 lo = _mm_loadu_ps(first + 9 * l + offset);
+		__m128 hi = _mm_loadu_ps(first + 9 * (l + 4) + offset);
+		r[l] = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+	}
+	transpose4x2(r);
+
+	__m256 o[3];
+	for (int k = 0; k < 3; k++) {
+		o[k] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[k][0], r[c]), _mm256_mul_ps(a[k][1], r[c + 1])), _mm256_add_ps(_mm256_mul_ps(a[k][2], r[c + 2]), a[k][3]));
+	}
+	r[c] = o[0];
+	r[c + 1] = o[1];
+	r[c + 2] = o[2];
+
+	transpose4x2(r);
+	for (int l = 0; l < 4; l++) {
+		_mm_storeu_ps(first + 9 * l + offset, _mm256_castps256_ps128(r[l]));
+		_mm_storeu_ps(first + 9 * (l + 4) + offset, _mm256_extractf128_ps(r[l], 1));
+	}
+}
+
+// 8 wide version of transformSSE().
+template <bool Normals>
+SIMD_TARGET_AVX2
+static size_t transformAVX2(Vertex* verts, size_t n, const AffineRows& P, const AffineRows& N) {
+	__m256 p[3][4];
+	__m256 q[3][4];
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 4; c++) {
+			p[r][c] = _mm256_set1_ps(P.m[r][c]);
+			q[r][c] = _mm256_set1_ps(N.m[r][c]);
+		}
+	}
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		float* first = reinterpret_cast<float*>(verts + i);
+		fieldAVX2(first, positionFloat, 0, p);
+		if (Normals) {
+			fieldAVX2(first, normalFloat, 1, q);
+		}
+	}
+	return i;
+}
+#endif
+
+template <bool Normals>
+static void transform(Vertex* verts, size_t n, const AffineRows& P, const AffineRows& N) {
+	size_t i = 0;
+
+#if SIMD_X86
+	CPU::SimdLevel level = CPU::simdLevel();
+	if (level == CPU::SIMD_AVX2) {
+		i = transformAVX2<Normals>(verts, n, P, N);
+	}
+	else if (level == CPU::SIMD_SSE) {
+		i = transformSSE<Normals>(verts, n, P, N);
+	}
+#endif
+
+	transformScalar<Normals>(verts, i, n, P, N);
+}
+
+void transformVertices(Vertex* verts, size_t n, const glm::mat4& M) {
+	AffineRows P = rowsof(M);
+	transform<false>(verts, n, P, P);
+}
+
+void transformVertices(Vertex* verts, size_t n, const glm::mat4& M, const glm::mat3& normalMat) {
+	transform<true>(verts, n, rowsof(M), rowsof(normalMat));
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// This file contains the kernel that moves batches of vertices by one affine
+// transform. The matrix is split up once per call instead of once per vertex,
+// and on x86-64 the vertices go through 4 (SSE) or 8 (AVX2) at a time, picked
+// at runtime through CPU::simdLevel() like the B-Spline kernels.
+//------------------------------------------------------------------------------
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "Geometry.h"
+
+// Replaces the positions of verts[0..n-1] with M * (position, 1). M has to be
+// affine (bottom row 0, 0, 0, 1), which every rotate/scale/translate product
+// and inverse view matrix is. Colors and normals are left alone.
+void transformVertices(Vertex* verts, size_t n, const glm::mat4& M);
+
+// Same, and replaces the normals with normalMat * normal. The normals are not
+// renormalised, so normalMat should be a rotation (or renormalised after).
+void transformVertices(Vertex* verts, size_t n, const glm::mat4& M, const glm::mat3& normalMat);
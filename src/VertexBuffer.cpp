@@ -24,8 +24,27 @@ VertexBuffer::VertexBuffer(GLuint index, GLint size, GLenum dataType)
 	glEnableVertexAttribArray(index);
 }
 
+VertexBuffer::VertexBuffer()
+	: bufferID{}
+{
+	bind();
+}
+
+
+void VertexBuffer::attribute(GLuint index, GLint size, GLenum dataType, GLboolean normalized, GLsizei stride, size_t offset) {
+	bind();
+	glVertexAttribPointer(index, size, dataType, normalized, stride, (void*)offset);
+	glEnableVertexAttribArray(index);
+}
+
 
 void VertexBuffer::uploadData(GLsizeiptr size, const void* data, GLenum usage) {
 	bind();
 	glBufferData(GL_ARRAY_BUFFER, size, data, usage);
+}
+
+
+void VertexBuffer::updateData(GLintptr offset, GLsizeiptr size, const void* data) {
+	bind();
+	glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
 }
\ No newline at end of file
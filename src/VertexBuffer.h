@@ -1,6 +1,7 @@
 #pragma once
 
 #include "GLHandles.h"
+#include <cstddef>
 #include <vector>
 #include <glad/glad.h>
 
@@ -10,6 +11,8 @@ class VertexBuffer {
 public:
 	VertexBuffer(std::vector<GLint> sizes, int stride);
 	VertexBuffer(GLuint index, GLint size, GLenum dataType);
+	// no attributes, set them up with attribute()
+	VertexBuffer();
 
 	// Because we're using the VertexBufferHandle to do RAII for the buffer for us
 	// and our other types are trivial or provide their own RAII
@@ -20,7 +23,11 @@ public:
 
 	// Public interface
 	void bind() const { glBindBuffer(GL_ARRAY_BUFFER, bufferID); }
+	// Reads attribute index from this buffer, at offset bytes into each vertex
+	void attribute(GLuint index, GLint size, GLenum dataType, GLboolean normalized, GLsizei stride, size_t offset);
 	void uploadData(GLsizeiptr size, const void* data, GLenum usage);
+	// overwrites part of the store allocated by uploadData()
+	void updateData(GLintptr offset, GLsizeiptr size, const void* data);
 
 private:
 	VertexBufferHandle bufferID;
@@ -0,0 +1,53 @@
+#include "VertexCache.h"
+
+#include <algorithm>
+
+
+CacheStats& CacheStats::operator+=(const CacheStats& other) {
+	triangles += other.triangles;
+	vertices += other.vertices;
+	transforms += other.transforms;
+	return *this;
+}
+
+
+CacheStats simulateStrips(const std::vector<unsigned int>& strips, unsigned int restart, int cacheSize) {
+	CacheStats stats;
+
+	unsigned int largest = 0;
+	for (unsigned int i : strips) {
+		if (i != restart) {
+			largest = std::max(largest, i);
+		}
+	}
+
+	// a vertex is cached while fewer than cacheSize others were transformed
+	// after it (FIFO), 0 means never transformed
+	std::vector<size_t> transformedAt(size_t(largest) + 1, 0);
+
+	size_t start = 0;
+	for (size_t k = 0; k < strips.size(); k++) {
+		unsigned int v = strips[k];
+		if (v == restart) {
+			start = k + 1;
+			continue;
+		}
+
+		if (transformedAt[v] == 0) {
+			stats.vertices++;
+		}
+		if (transformedAt[v] == 0 || stats.transforms + 1 - transformedAt[v] > size_t(cacheSize)) {
+			stats.transforms++;
+			transformedAt[v] = stats.transforms;
+		}
+
+		if (k >= start + 2) {
+			unsigned int a = strips[k - 2];
+			unsigned int b = strips[k - 1];
+			if (a != b && b != v && a != v) {
+				stats.triangles++;
+			}
+		}
+	}
+	return stats;
+}
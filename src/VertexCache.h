@@ -0,0 +1,34 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// This file contains a model of the GPU's post-transform vertex cache, for
+// measuring how well an index order reuses vertices that were already
+// transformed. The cache is modelled as FIFO, which is what the usual ACMR
+// and ATVR figures assume.
+//------------------------------------------------------------------------------
+
+#include <cstddef>
+#include <vector>
+
+// Vertex cache size the index orders are tuned for and measured with
+const int vertexCacheSize = 16;
+
+struct CacheStats {
+	// not counting degenerate triangles
+	size_t triangles = 0;
+	// distinct vertices the indices use
+	size_t vertices = 0;
+	// vertices transformed, i.e. cache misses
+	size_t transforms = 0;
+
+	// average cache miss ratio, transforms per triangle (0.5 at best on a grid)
+	double acmr() const { return (triangles > 0) ? double(transforms) / double(triangles) : 0.0; }
+	// average transform to vertex ratio (1 at best)
+	double atvr() const { return (vertices > 0) ? double(transforms) / double(vertices) : 0.0; }
+
+	CacheStats& operator+=(const CacheStats& other);
+};
+
+// Simulates drawing triangle strips separated by restart indices. The cache
+// is kept across restarts, as it is within one draw call.
+CacheStats simulateStrips(const std::vector<unsigned int>& strips, unsigned int restart, int cacheSize = vertexCacheSize);
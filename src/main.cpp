@@ -9,6 +9,7 @@
 #include <vector>
 #include <limits>
 #include <functional>
+#include <chrono>
 #include <unordered_map>
 
 // Window.h `#include`s ImGui, GLFW, and glad in correct order.
@@ -22,6 +23,10 @@
 #include "Camera.h"
 #include "Mesh.h"
 #include "Line.h"
+#include "StrokeBuilder.h"
+#include "PointPicker.h"
+#include "ThreadPool.h"
+#include "MeshJobs.h"
 
 #include "Renderbuffer.h"
 #include "Framebuffer.h"
@@ -159,6 +164,29 @@ public:
 		glUniform1f(ambientStrengthLoc, ambientStrength);
 	}
 
+	// Colour of the next object drawn, after lightingShader.use()
+	void updateLightingColor(const glm::vec3 &color)
+	{
+		glUniform3f(lightingColorLoc, color.r, color.g, color.b);
+	}
+
+	// Colour of the next object drawn, after noLightingShader.use()
+	void updateNoLightingColor(const glm::vec3 &color)
+	{
+		glUniform3f(noLightingColorLoc, color.r, color.g, color.b);
+	}
+
+	// Radius in pixels a sphere is drawn with, 0 if the camera is inside it
+	float projectedRadius(glm::vec3 center, float radius)
+	{
+		float distance = glm::distance(camera.getPos(), center);
+		if (distance <= radius)
+			return 0.f;
+		// the sphere's silhouette is a cone of half angle asin(radius / distance)
+		float tangent = radius / std::sqrt(distance * distance - radius * radius);
+		return tangent / glm::tan(glm::radians(22.5f)) * 0.5f * float(screenHeight);
+	}
+
 	// Converts the cursor position from screen coordinates to GL coordinates
 	// and returns the result.
 	glm::vec2 getCursorPosGL()
@@ -180,44 +208,22 @@ public:
 		return glm::vec2(mouseOldX, mouseOldY);
 	}
 
-	int indexOfPointAtCursorPos(std::vector<Vertex>& glCoordsOfPointsToSearch, float screenCoordThreshold, Camera current) {
+	// Nearest point of the line within screenCoordThreshold of the cursor, or -1.
+	// The projected points are cached on the line and only rebuilt when the
+	// line (its revision), the camera or the window change.
+	int indexOfPointAtCursorPos(const Line& pointsToSearch, float screenCoordThreshold, Camera& current) {
+		PointPicker& picker = pointsToSearch.picker;
 
-		std::vector<glm::vec3> screenCoordVerts;
-		for (const auto& v : glCoordsOfPointsToSearch) {
-			screenCoordVerts.push_back(glm::vec3(glPosToScreenCoords(current.getMousePos(glm::vec4(v.position, 1.f))), 0.f));
-		}
+		PickKey key{ pointsToSearch.verts.data(), pointsToSearch.verts.size(), pointsToSearch.revision,
+			current.theta, current.phi, current.radius, screenWidth, screenHeight, screenCoordThreshold };
+		picker.update(pointsToSearch.verts, key, current);
 
 		glm::vec2 screenMouse = cursorPosScreenCoords();
-		glm::vec3 cursorPosScreen(screenMouse.x + 0.5f, screenMouse.y + 0.5f, 0.f);
-
-		for (size_t i = 0; i < screenCoordVerts.size(); i++) {
-			// Return i if length of difference vector within threshold.
-			glm::vec3 diff = screenCoordVerts[i] - cursorPosScreen;
-			if (glm::length(diff) < screenCoordThreshold) {
-				return i;
-			}
-		}
-		return -1; // No point within threshold found.
+		return picker.nearest(glm::vec2(screenMouse.x + 0.5f, screenMouse.y + 0.5f), screenCoordThreshold);
 	}
 
-	int onaxis_indexOfPointAtCursorPos(std::vector<Vertex>& glCoordsOfPointsToSearch, float screenCoordThreshold, Camera current) {
-
-		std::vector<glm::vec3> screenCoordVerts;
-		for (const auto& v : glCoordsOfPointsToSearch) {
-			screenCoordVerts.push_back(glm::vec3(glPosToScreenCoords(current.getMousePos(glm::vec4(v.position, 1.f))), 0.f));
-		}
-
-		glm::vec2 screenMouse = cursorPosScreenCoords();
-		glm::vec3 cursorPosScreen(screenMouse.x + 0.5f, screenMouse.y + 0.5f, 0.f);
-
-		for (size_t i = 0; i < screenCoordVerts.size(); i++) {
-			// Return i if length of difference vector within threshold.
-			glm::vec3 diff = screenCoordVerts[i] - cursorPosScreen;
-			if (glm::length(diff) < screenCoordThreshold) {
-				return i;
-			}
-		}
-		return -1; // No point within threshold found.
+	int onaxis_indexOfPointAtCursorPos(const Line& pointsToSearch, float screenCoordThreshold, Camera& current) {
+		return indexOfPointAtCursorPos(pointsToSearch, screenCoordThreshold, current);
 	}
 
 	glm::vec3 getWorldPos() {
@@ -260,10 +266,12 @@ private:
 		lightingMLoc = glGetUniformLocation(lightingShader, "M");
 		lightingVLoc = glGetUniformLocation(lightingShader, "V");
 		lightingPLoc = glGetUniformLocation(lightingShader, "P");
+		lightingColorLoc = glGetUniformLocation(lightingShader, "objColor");
 
 		noLightingMLoc = glGetUniformLocation(noLightingShader, "M");
 		noLightingVLoc = glGetUniformLocation(noLightingShader, "V");
 		noLightingPLoc = glGetUniformLocation(noLightingShader, "P");
+		noLightingColorLoc = glGetUniformLocation(noLightingShader, "objColor");
 
 		mLocPicker = glGetUniformLocation(pickerShader, "M");
 		vLocPicker = glGetUniformLocation(pickerShader, "V");
@@ -286,10 +294,12 @@ private:
 	GLint lightingMLoc;
 	GLint lightingVLoc;
 	GLint lightingPLoc;
+	GLint lightingColorLoc;
 
 	GLint noLightingMLoc;
 	GLint noLightingVLoc;
 	GLint noLightingPLoc;
+	GLint noLightingColorLoc;
 
 	GLint mLocPicker;
 	GLint vLocPicker;
@@ -349,90 +359,205 @@ void drawCurve(std::vector<Line> &lines, std::vector<Line> &points, Line control
 	pointsInProgress = nullptr;
 }
 
-void updateMesh(Mesh& mesh, Line bound1, Line bound2, Line profile1, Line profile2, Line crosssection, int precision, glm::vec3 color) {
-	Mesh newmesh;
-	Mesh tempmesh;
-
+// Gives mesh its new input curves, the geometry is regenerated separately
+void setMeshInputs(Mesh& mesh, const Line& bound1, const Line& bound2, const Line& profile1, const Line& profile2, const Line& crosssection) {
+	mesh.ctrlpts1 = bound1.verts;
+	mesh.ctrlpts2 = bound2.verts;
+	mesh.sweep = crosssection.verts;
 	if (profile1.verts.size() != 0 && profile2.verts.size() != 0) {
-		newmesh.ctrlpts1 = bound1.verts;
-		newmesh.ctrlpts2 = bound2.verts;
-		newmesh.cam = mesh.cam;
-		newmesh.sweep = crosssection.verts;
-		newmesh.create(precision);
-		tempmesh = newmesh.gettempmesh();
-
-		glm::vec3 axis = newmesh.getAxis();
-		// fix angle
-		// first isolate to direction of up
-		glm::vec3 testup = axis * mesh.cam.getUp();
-		if ((testup.x + testup.y + testup.z) < 0) {
-			axis = axis * (glm::vec3(-1.f));
-		}
-		float ptheta = glm::orientedAngle(newmesh.cam.getUp(), axis, -newmesh.cam.getPos());
-
 		mesh.pinch1 = profile1.verts;
-		tempmesh.pinch1 = profile1.verts;
 		mesh.pinch2 = profile2.verts;
-		tempmesh.pinch2 = profile2.verts;
-		tempmesh.create(precision);
-		tempmesh.updateGPU();
-
-		mesh.verts.clear();
-		for (auto j = tempmesh.verts.begin(); j < tempmesh.verts.end(); j++) {
-			(*j).position = glm::translate(glm::mat4(1.f), newmesh.getCenter()) * glm::rotate(glm::mat4(1.f), ptheta, -newmesh.cam.getPos()) * glm::vec4((*j).position, 1.f);
-			(*j).normal = glm::rotate(glm::mat4(1.f), ptheta, -newmesh.cam.getPos()) * glm::vec4((*j).normal, 0.f);
-			mesh.verts.push_back((*j));
-		}
-		mesh.ctrlpts1 = bound1.verts;
-		mesh.ctrlpts2 = bound2.verts;
-		mesh.setColor(color);
-		mesh.updateGPU();
+	}
+}
+
+// Regenerates the geometry of mesh from its inputs without touching the GPU,
+// so it can run on any thread. Returns true if all of it changed, otherwise
+// only verts[first..first + count) did.
+bool rebuildMesh(Mesh& mesh, int precision, glm::vec3 color, ThreadPool* pool, size_t& first, size_t& count) {
+	if (mesh.pinch1.verts.size() != 0 && mesh.pinch2.verts.size() != 0) {
+		// built in the profiles' frame and placed back as it is generated
+		Mesh tempmesh = mesh.gettempmesh();
+		tempmesh.pinch1 = mesh.pinch1.verts;
+		tempmesh.pinch2 = mesh.pinch2.verts;
+		glm::mat4 tolocal;
+		mesh.canonicalframe(tempmesh.placement, tolocal);
+		tempmesh.create(precision, pool);
+
+		mesh.verts.swap(tempmesh.verts);
+		mesh.axis.swap(tempmesh.axis);
+		// the ring count can change with adaptive tessellation
+		mesh.topology = tempmesh.topology;
+		mesh.recolor(color);
+		// these verts did not come from mesh.create(), the next update() starts over
+		mesh.built = Mesh::BuildState();
+
+		first = 0;
+		count = mesh.verts.size();
+		return true;
 	}
 
-	else {
-		mesh.ctrlpts1 = bound1.verts;
-		mesh.ctrlpts2 = bound2.verts;
-		mesh.sweep = crosssection.verts;
-		mesh.create(precision);
+	// rebuilds only the rings the moved control points reach when it can
+	return mesh.update(precision, first, count, pool);
+}
+
+// setMeshInputs() and rebuildMesh() right away, then uploads what changed
+void updateMesh(Mesh& mesh, const Line& bound1, const Line& bound2, const Line& profile1, const Line& profile2, const Line& crosssection, int precision, glm::vec3 color, ThreadPool* pool = nullptr) {
+	setMeshInputs(mesh, bound1, bound2, profile1, profile2, crosssection);
+
+	size_t first;
+	size_t count;
+	if (rebuildMesh(mesh, precision, color, pool, first, count)) {
 		mesh.updateGPU();
 	}
+	else if (count > 0) {
+		mesh.updateGPU(first, count);
+	}
+}
+
+// updateMesh() of meshes[index] without stalling the frame. The inputs change
+// right away. If only some rings change they are rebuilt in the background;
+// otherwise a preview that fits in budget seconds is built right here and the
+// background refines it to precision, jobs.poll() swapping each level in.
+void updateMeshAsync(MeshJobs& jobs, std::vector<Mesh>& meshes, int index, const Line& bound1, const Line& bound2, const Line& profile1, const Line& profile2, const Line& crosssection, int precision, double budget, ThreadPool* pool) {
+	Mesh& mesh = meshes[index];
+	setMeshInputs(mesh, bound1, bound2, profile1, profile2, crosssection);
+
+	// the colour is the mesh's own, jobs.poll() recolours with the one it has then
+	MeshJobs::Build build = [pool](Mesh& work, int precision, size_t& first, size_t& count) {
+		return rebuildMesh(work, precision, work.color, pool, first, count);
+	};
+
+	if (mesh.incremental(precision)) {
+		jobs.submit(index, mesh, build, std::vector<int>{ precision });
+		return;
+	}
+
+	// the first level right away, the rest (if any) in the background
+	std::vector<int> levels = jobs.plan(precision, budget);
+	jobs.cancel(index);
+
+	size_t first;
+	size_t count;
+	auto start = std::chrono::steady_clock::now();
+	build(mesh, levels[0], first, count);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	jobs.measured(levels[0], elapsed.count());
+	mesh.updateGPU();
+
+	levels.erase(levels.begin());
+	if (!levels.empty()) {
+		jobs.submit(index, mesh, build, levels);
+	}
+}
+
+// copies the stroke from point first on into the line being drawn and uploads that tail
+void updateStroke(Line& line, const StrokeBuilder& stroke, size_t first, glm::vec3 color) {
+	const std::vector<glm::vec3>& points = stroke.points();
+
+	line.verts.resize(first);
+	for (size_t i = first; i < points.size(); i++) {
+		line.verts.push_back(Vertex{ points[i], color, glm::vec3(0.f) });
+	}
+	line.updateGPU(first);
+}
+
+// replaces the line with the evenly resampled stroke, ready for Chaikin
+void finishStroke(Line& line, const StrokeBuilder& stroke, glm::vec3 color) {
+	std::vector<glm::vec3> points;
+	stroke.resample(points);
+
+	line.verts.clear();
+	for (auto p = points.begin(); p < points.end(); p++) {
+		line.verts.push_back(Vertex{ (*p), color, glm::vec3(0.f) });
+	}
+}
+
+// Concatenation of line(i, out) for i in [0, count), built in blocks of lines
+// spread over the pool and joined in order
+std::string buildLines(ThreadPool* pool, size_t count, const std::function<void(size_t, std::string&)>& line)
+{
+	const size_t blockSize = 1024;
+	std::vector<std::string> blocks((count + blockSize - 1) / blockSize);
+	parallelFor(pool, 0, blocks.size(), 1, [&](size_t first, size_t last) {
+		for (size_t b = first; b < last; b++)
+		{
+			for (size_t i = b * blockSize; i < std::min(count, (b + 1) * blockSize); i++)
+			{
+				line(i, blocks[b]);
+			}
+		}
+	});
+
+	std::string joined;
+	for (std::string &block : blocks)
+	{
+		joined += block;
+	}
+	return joined;
 }
 
 // return true if export was successful, false otherwise
-bool exportToObj(std::string filename, std::vector<Mesh> &meshes)
+bool exportToObj(std::string filename, std::vector<Mesh> &meshes, ThreadPool* pool = nullptr)
 {
 	try
 	{
-		std::string verticesString;
-		std::string normalsString;
-		std::vector<std::string> faceGroups;
+		std::vector<std::string> verticesStrings(meshes.size());
+		std::vector<std::string> normalsStrings(meshes.size());
+		std::vector<std::string> faceGroups(meshes.size());
 
-		int offset = 1;
+		// vertex numbers are global in the file, each mesh starts after the previous ones
+		std::vector<size_t> offsets(meshes.size());
+		size_t offset = 1;
 		for (int i = 0; i < meshes.size(); i++)
 		{
-			Mesh &mesh = meshes[i];
-
-			for (Vertex &vert : mesh.verts)
-			{
-				verticesString += "v " + std::to_string(vert.position.x) + " " + std::to_string(vert.position.y) + " " + std::to_string(vert.position.z) + "\n";
-				normalsString += "vn " + std::to_string(vert.normal.x) + " " + std::to_string(vert.normal.y) + " " + std::to_string(vert.normal.z) + "\n";
-			}
+			offsets[i] = offset;
+			offset += meshes[i].verts.size();
+		}
 
-			std::string groupString = "g object " + std::to_string(i) + "\n";
-			for (int i = 2; i < mesh.indices.size(); i += 3)
+		parallelFor(pool, 0, meshes.size(), 1, [&](size_t first, size_t last) {
+			for (size_t i = first; i < last; i++)
 			{
-				// groupString += "f " + std::to_string(mesh.indices[i - 2] + offset) + " " + std::to_string(mesh.indices[i - 1] + offset) + " " + std::to_string(mesh.indices[i] + offset) + "\n";
-				groupString += "f " + std::to_string(mesh.indices[i - 2] + offset) + "//" + std::to_string(mesh.indices[i - 2] + offset) + " " + std::to_string(mesh.indices[i - 1] + offset) + "//" + std::to_string(mesh.indices[i - 1] + offset) + " " + std::to_string(mesh.indices[i] + offset) + "//" + std::to_string(mesh.indices[i] + offset) + "\n";
+				Mesh &mesh = meshes[i];
+				size_t meshOffset = offsets[i];
+
+				verticesStrings[i] = buildLines(pool, mesh.verts.size(), [&](size_t j, std::string& out) {
+					const Vertex &vert = mesh.verts[j];
+					out += "v " + std::to_string(vert.position.x) + " " + std::to_string(vert.position.y) + " " + std::to_string(vert.position.z) + "\n";
+				});
+				normalsStrings[i] = buildLines(pool, mesh.verts.size(), [&](size_t j, std::string& out) {
+					const Vertex &vert = mesh.verts[j];
+					out += "vn " + std::to_string(vert.normal.x) + " " + std::to_string(vert.normal.y) + " " + std::to_string(vert.normal.z) + "\n";
+				});
+
+				std::string groupString = "g object " + std::to_string(i) + "\n";
+				// the caps are triangles, the rest quads
+				const SurfaceGrid& grid = mesh.topology->grid();
+				groupString += buildLines(pool, grid.faceCount(), [&](size_t j, std::string& out) {
+					size_t corners[4];
+					int n = grid.face(j, corners);
+					out += "f";
+					for (int k = 0; k < n; k++) {
+						std::string v = std::to_string(corners[k] + meshOffset);
+						out += " " + v + "//" + v;
+					}
+					out += "\n";
+				});
+				faceGroups[i] = groupString;
 			}
-			faceGroups.push_back(groupString);
-
-			offset += mesh.verts.size();
-		}
+		});
 
 		std::ofstream outfile(filename);
 
-		outfile << verticesString << std::endl;
-		outfile << normalsString << std::endl;
+		for (std::string &verticesString : verticesStrings)
+		{
+			outfile << verticesString;
+		}
+		outfile << std::endl;
+		for (std::string &normalsString : normalsStrings)
+		{
+			outfile << normalsString;
+		}
+		outfile << std::endl;
 		for (std::string &groupString : faceGroups)
 		{
 			outfile << groupString << std::endl;
@@ -548,6 +673,8 @@ int main()
 	bool showAxes = true;
 	bool simpleWireframe = false;
 	bool showbounds = false;
+	// draw meshes at lower resolution when they are small on screen
+	bool levelOfDetail = true;
 	bool hide = false;
 	// bool sweep = false;
 
@@ -573,6 +700,7 @@ int main()
 	std::vector<Line> lines;
 	Line* lineInProgress = nullptr;
 	float pointEpsilon = 0.01f;
+	StrokeBuilder stroke(pointEpsilon, 0.002f);
 
 	glm::vec3 boundColor{ 1.0f, 0.7f, 0.0f };
 	std::vector<Line> bounds;
@@ -590,6 +718,26 @@ int main()
 	float pointSize = 5.0f;
 	int precision = 150;
 
+	// shared by the geometry kernels, the Threads slider resizes it
+	int threadCount = int(ThreadPool::hardwareThreads());
+	ThreadPool pool(threadCount);
+	// regenerates meshes after "Accept Changes" without stalling the frame,
+	// the first preview has to fit in previewBudgetMs
+	MeshJobs jobs;
+	float previewBudgetMs = 8.f;
+	Tessellation tess;
+	float angleToleranceDeg = glm::degrees(tess.angleTolerance);
+
+	// the segments around a ring are set apart from the rings, a smooth
+	// cross-section needs far fewer of them
+	Tessellation sweepTess;
+	sweepTess.adaptive = true;
+	sweepTess.chordTolerance = 0.005f;
+	sweepTess.angleTolerance = glm::radians(12.f);
+	sweepTess.maxSamples = 150;
+	float sweepAngleDeg = glm::degrees(sweepTess.angleTolerance);
+	int ringSegments = 48;
+
 	std::vector<int> ptmodify = std::vector{ -1,-1 };
 
 	char ObjFilename[] = "";
@@ -600,6 +748,8 @@ int main()
 	glm::vec3 meshCol;
 
 	int chaikin_iter = 2;
+	float fitTolerance = 0.005f;
+	int maxControlPoints = 40;
 	bool chaikin_change = true;
 
 	enum ViewType
@@ -623,6 +773,11 @@ int main()
 		cb->incrementFrameCount();
 		glfwPollEvents();
 
+		// meshes regenerated in the background since the last frame
+		jobs.poll(meshes);
+		// and the triangle lists the meshes they replaced were the last users of
+		Topology::trim();
+
 		// Detect Hovered Objects in FREE_VIEW
 		if (view == FREE_VIEW)
 			hoveredObjectIndex = findSelectedObjectIndex(pickerFB, pickerTex, pickerShader, cb, window, meshes);
@@ -651,28 +806,19 @@ int main()
 			if (lineInProgress)
 			{
 				// add points to line in progress
-				Vertex lastVertex = lineInProgress->verts.back();
-				glm::vec3 slope = glm::vec3(cursorPos) - lastVertex.position;
-				float pointDistance = glm::length(slope);
-				slope = glm::normalize(slope);
-
-				for (float dist = pointEpsilon; dist <= pointDistance; dist += pointEpsilon)
-				{
-					Vertex newPoint = Vertex{ lastVertex.position + slope * dist, lineColor, glm::vec3(0.0f) };
-					lineInProgress->verts.push_back(newPoint);
-				}
-
-				lineInProgress->updateGPU();
+				size_t first = stroke.add(glm::vec3(cursorPos));
+				updateStroke(*lineInProgress, stroke, first, lineColor);
 
 				// if line is in progress and user reaches the other boundary line, end the line in progress
 				if (view == CROSS_DRAW) {
-					int newindex = cb->indexOfPointAtCursorPos(static_points[abs(1 - selectedCurveIndex)].verts, pointSize, cam);
+					int newindex = cb->indexOfPointAtCursorPos(static_points[abs(1 - selectedCurveIndex)], pointSize, cam);
 					if (newindex != -1) {
+						finishStroke(*lineInProgress, stroke, lineColor);
 						lineInProgress->verts.push_back(static_points[abs(1-selectedCurveIndex)].verts[newindex]);
 						selectedCurveIndex = -1;
 						selectedPointIndex = -1;
 						lineInProgress->updateGPU();
-						lineInProgress->ChaikinAlg(chaikin_iter);
+						lineInProgress->FitBSpline(fitTolerance, maxControlPoints);
 
 						Line mypoints = Line(lineInProgress->verts);
 						lines.pop_back();
@@ -709,23 +855,24 @@ int main()
 				lines.emplace_back(std::vector<Vertex>{Vertex{ cursorPos, lineColor, glm::vec3(0.0f) }});
 				lineInProgress = &lines.back();
 				lineInProgress->updateGPU();
+				stroke.begin(glm::vec3(cursorPos));
 			}
 			// exception is cross section drawing where the boundary lines are shown
 			else if (view == CROSS_DRAW && lines.size() < 1) {
 				selectedPointIndex = -1;
 				for (int i = 0; i < static_points.size(); i++) {
 					if (selectedPointIndex == -1) {
-						selectedPointIndex = cb->indexOfPointAtCursorPos(static_points[i].verts, pointSize, cam);
+						selectedPointIndex = cb->indexOfPointAtCursorPos(static_points[i], pointSize, cam);
 						selectedCurveIndex = i;
 						
 						if (selectedPointIndex != -1) {
-							static_points[selectedCurveIndex].verts[selectedPointIndex].color = lineColor;
-							static_points[selectedCurveIndex].updateGPU();
-
-							// create a new line
-							lines.emplace_back(std::vector<Vertex>{static_points[selectedCurveIndex].verts[selectedPointIndex], Vertex{ cursorPos, lineColor, glm::vec3(0.0f) }});
+							// create a new line, the point it starts at is drawn in its colour
+							Vertex start = static_points[selectedCurveIndex].verts[selectedPointIndex];
+							start.color = lineColor;
+							lines.emplace_back(std::vector<Vertex>{start});
 							lineInProgress = &lines.back();
-							lineInProgress->updateGPU();
+							stroke.begin(lineInProgress->verts[0].position);
+							updateStroke(*lineInProgress, stroke, stroke.add(glm::vec3(cursorPos)), lineColor);
 						}
 					}
 				}
@@ -734,7 +881,7 @@ int main()
 		//clean up lines, run chaikin if mouse is lifted
 		else if (!(cb->leftMouseDown) && lineInProgress != nullptr)
 		{
-			if (view == CROSS_DRAW || lineInProgress->verts.size() < 4) {
+			if (view == CROSS_DRAW || stroke.sampleCount() < 4) {
 				if (view == CROSS_DRAW) {
 					static_points[0].setColor(black);
 					static_points[0].updateGPU();
@@ -746,7 +893,8 @@ int main()
 				lines.pop_back();
 			}
 			else {
-				lineInProgress->ChaikinAlg(chaikin_iter);
+				finishStroke(*lineInProgress, stroke, lineColor);
+				lineInProgress->FitBSpline(fitTolerance, maxControlPoints);
 				modify_points.emplace_back(Line(lineInProgress->verts));
 
 				pointsInProgress = &modify_points.back();
@@ -767,7 +915,7 @@ int main()
 			if (view == CURVE_VIEW || view == PROFILE_EDIT || view == CROSS_EDIT) {
 				for (int i = 0; i < modify_points.size(); i++) {
 					if (selectedPointIndex == -1) {
-						selectedPointIndex = cb->indexOfPointAtCursorPos(modify_points[i].verts, pointSize, cam);
+						selectedPointIndex = cb->indexOfPointAtCursorPos(modify_points[i], pointSize, cam);
 						selectedCurveIndex = i;
 					}
 				}
@@ -776,10 +924,13 @@ int main()
 		// drag points
 		else if ((view == CURVE_VIEW || view == CROSS_EDIT || view == PROFILE_EDIT) && cb->leftMouseDown && selectedPointIndex != -1) {
 			modify_points[selectedCurveIndex].verts[selectedPointIndex].position = cam.getCursorPos(cb->getCursorPosGL());
-			modify_points[selectedCurveIndex].updateGPU();
-			lines[selectedCurveIndex].verts = modify_points[selectedCurveIndex].verts;
-			lines[selectedCurveIndex].BSpline(precision, lines[selectedCurveIndex].col);
-			lines[selectedCurveIndex].updateGPU();
+			modify_points[selectedCurveIndex].updateGPU(selectedPointIndex, 1);
+
+			// only the samples near the moved control point change
+			int first;
+			int last;
+			lines[selectedCurveIndex].UpdateBSpline(modify_points[selectedCurveIndex].verts, precision, first, last);
+			lines[selectedCurveIndex].updateGPU(first, last - first);
 			pointsInProgress = nullptr;
 			lineInProgress = nullptr;
 		}
@@ -795,6 +946,29 @@ int main()
 		if (view == FREE_VIEW)
 		{
 			ImGui::Begin("Free View");
+			// resizing restarts the workers, so only once the slider is let go
+			ImGui::SliderInt("Threads", &threadCount, 1, int(ThreadPool::hardwareThreads()));
+			if (ImGui::IsItemDeactivatedAfterEdit())
+			{
+				jobs.finish(meshes);
+				pool.resize(unsigned(threadCount));
+			}
+			ImGui::SliderFloat("Preview Budget", &previewBudgetMs, 1.f, 50.f, "%.0f ms");
+			ImGui::Checkbox("Level of Detail", &levelOfDetail);
+
+			// simulated vertex cache use of the scene, ring by ring order -> drawn order
+			CacheStats ringOrder;
+			CacheStats drawnOrder;
+			for (Mesh& mesh : meshes) {
+				if (mesh.topology) {
+					ringOrder += mesh.topology->ringOrderStats();
+					drawnOrder += mesh.topology->cacheStats();
+				}
+			}
+			ImGui::Text("ACMR: %.3f -> %.3f", ringOrder.acmr(), drawnOrder.acmr());
+			ImGui::Text("ATVR: %.3f -> %.3f", ringOrder.atvr(), drawnOrder.atvr());
+			ImGui::Text("");
+
 			ImGui::Text("Export to .obj");
 			ImGui::InputText("Filename", ObjFilename, size_t(32));
 			if (sizeof(ObjFilename) > 0 && ImGui::Button("Save"))
@@ -803,7 +977,8 @@ int main()
 				if (filename.find(".obj") == std::string::npos)
 					filename += ".obj";
 
-				bool isSuccessful = exportToObj(filename, meshes);
+				jobs.finish(meshes);
+				bool isSuccessful = exportToObj(filename, meshes, &pool);
 				if (isSuccessful)
 				{
 					ImGui::OpenPopup("ExportObjSuccessPopup");
@@ -849,6 +1024,29 @@ int main()
 			ImGui::ColorEdit3("New Object Color", (float*)&lineColor);
 			ImGui::Text("");
 
+			ImGui::SliderFloat("Fit Tolerance", &fitTolerance, 0.001f, 0.05f, "%.3f", ImGuiSliderFlags_Logarithmic);
+			ImGui::SliderInt("Max Control Points", &maxControlPoints, 4, 200);
+			ImGui::NewLine();
+
+			ImGui::Checkbox("Arc Length Rings", &tess.arcLength);
+			ImGui::Checkbox("Adaptive Tessellation", &tess.adaptive);
+			if (tess.adaptive) {
+				ImGui::SliderFloat("Chordal Tolerance", &tess.chordTolerance, 0.0002f, 0.02f, "%.4f", ImGuiSliderFlags_Logarithmic);
+				ImGui::SliderFloat("Angle Tolerance", &angleToleranceDeg, 1.f, 30.f, "%.1f deg");
+				ImGui::SliderInt("Max Rings", &tess.maxSamples, 16, 1000);
+				tess.angleTolerance = glm::radians(angleToleranceDeg);
+			}
+			ImGui::Checkbox("Adaptive Cross-Sections", &sweepTess.adaptive);
+			if (sweepTess.adaptive) {
+				ImGui::SliderFloat("Cross-Section Tolerance", &sweepTess.chordTolerance, 0.0005f, 0.05f, "%.4f", ImGuiSliderFlags_Logarithmic);
+				ImGui::SliderFloat("Cross-Section Angle", &sweepAngleDeg, 2.f, 45.f, "%.1f deg");
+				sweepTess.angleTolerance = glm::radians(sweepAngleDeg);
+			}
+			else {
+				ImGui::SliderInt("Ring Segments", &ringSegments, 8, 300);
+			}
+			ImGui::Text("");
+
 			std::string linesDrawn = "Lines Drawn: " + std::to_string(lines.size()) + "/" + std::to_string(2);
 			if (lines.size() == 2)
 				ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32(0, 255, 0, 255));
@@ -891,9 +1089,10 @@ int main()
 					modify_points.pop_back();
 
 					// sets default 'sweep'/'crosssection'
-					meshInProgress->sweep = cam.getcircle(precision);
+					meshInProgress->sweep = cam.getcircle(circleSegments(sweepTess, ringSegments));
 					meshInProgress->cam = cam;
-					meshInProgress->create(precision);
+					meshInProgress->tess = tess;
+					meshInProgress->create(precision, &pool);
 					meshInProgress->setColor(lineColor);
 					meshInProgress->updateGPU();
 					meshInProgress = nullptr;
@@ -934,9 +1133,11 @@ int main()
 			
 				cam = meshes[selectedObjectIndex].cam;
 
+				// gettempmesh() works from the settled boundary curves
+				jobs.finish(meshes);
 				tempmesh = meshes[selectedObjectIndex].gettempmesh();
-				tempmesh.create(precision);
-				updateMesh(tempmesh, tempmesh.ctrlpts1.verts, tempmesh.ctrlpts2.verts, meshes[selectedObjectIndex].pinch1.verts, meshes[selectedObjectIndex].pinch2.verts, meshes[selectedObjectIndex].sweep.verts, precision, tempmesh.color);
+				tempmesh.create(precision, &pool);
+				updateMesh(tempmesh, tempmesh.ctrlpts1.verts, tempmesh.ctrlpts2.verts, meshes[selectedObjectIndex].pinch1.verts, meshes[selectedObjectIndex].pinch2.verts, meshes[selectedObjectIndex].sweep.verts, precision, tempmesh.color, &pool);
 				tempmesh.crosssection = meshes[selectedObjectIndex].crosssection.verts;
 				tempmesh.updateGPU();
 
@@ -992,6 +1193,7 @@ int main()
 			if (ImGui::Button("Delete"))
 			{
 				meshes.erase(meshes.begin() + selectedObjectIndex);
+				jobs.erased(selectedObjectIndex);
 				view = FREE_VIEW;
 				change = true;
 				selectedObjectIndex = -1;
@@ -1090,7 +1292,7 @@ int main()
 
 				if (ImGui::Button("Accept Changes"))
 				{
-					updateMesh(meshes[selectedObjectIndex], Line(modify_points[0].verts), Line(modify_points[1].verts), Line(meshes[selectedObjectIndex].pinch1.verts), Line(meshes[selectedObjectIndex].pinch2.verts), Line(meshes[selectedObjectIndex].sweep.verts), precision, meshes[selectedObjectIndex].color);
+					updateMeshAsync(jobs, meshes, selectedObjectIndex, Line(modify_points[0].verts), Line(modify_points[1].verts), Line(meshes[selectedObjectIndex].pinch1.verts), Line(meshes[selectedObjectIndex].pinch2.verts), Line(meshes[selectedObjectIndex].sweep.verts), precision, previewBudgetMs / 1000.0, &pool);
 					modify_points.clear();
 					lines.clear();
 					view = OBJECT_VIEW;
@@ -1126,7 +1328,7 @@ int main()
 						lines.clear();
 						modify_points.clear();
 
-						std::vector<Line> pinches = tempmesh.getPinches(precision);
+						std::vector<Line> pinches = tempmesh.getPinches();
 
 						drawCurve(lines, modify_points, Line(pinches[0].verts), meshes[selectedObjectIndex].color, black, precision);
 						drawCurve(lines, modify_points, Line(pinches[1].verts), meshes[selectedObjectIndex].color, black, precision);
@@ -1189,11 +1391,11 @@ int main()
 
 				if (lines.size() == 2 && meshes.size() != 0) {
 					if (ImGui::Button("Accept Changes")) {
-						updateMesh(meshes[selectedObjectIndex], Line(meshes[selectedObjectIndex].ctrlpts1.verts), Line(meshes[selectedObjectIndex].ctrlpts2.verts), Line(modify_points[0].verts), Line(modify_points[1].verts), Line(meshes[selectedObjectIndex].sweep.verts), precision, meshes[selectedObjectIndex].color);
+						updateMeshAsync(jobs, meshes, selectedObjectIndex, Line(meshes[selectedObjectIndex].ctrlpts1.verts), Line(meshes[selectedObjectIndex].ctrlpts2.verts), Line(modify_points[0].verts), Line(modify_points[1].verts), Line(meshes[selectedObjectIndex].sweep.verts), precision, previewBudgetMs / 1000.0, &pool);
 						
 						tempmesh.pinch1 = modify_points[0].verts;
 						tempmesh.pinch2 = modify_points[1].verts;
-						tempmesh.create(precision);
+						tempmesh.create(precision, &pool);
 						tempmesh.updateGPU();
 
 						modify_points.clear();
@@ -1339,9 +1541,9 @@ int main()
 			if (lines.size() == 1){
 				if (ImGui::Button("Accept Changes")) {
 					Line newcross;
-					meshes[selectedObjectIndex].setcrosssection(modify_points.back().verts, glm::vec3(1.f) - glm::abs(glm::normalize(cam.getPos())), precision);
+					meshes[selectedObjectIndex].setcrosssection(modify_points.back().verts, glm::vec3(1.f) - glm::abs(glm::normalize(cam.getPos())), ringSegments, sweepTess);
 					
-					updateMesh(meshes[selectedObjectIndex], meshes[selectedObjectIndex].ctrlpts1.verts, meshes[selectedObjectIndex].ctrlpts2.verts, meshes[selectedObjectIndex].pinch1.verts, meshes[selectedObjectIndex].pinch2.verts, meshes[selectedObjectIndex].sweep.verts, precision, meshes[selectedObjectIndex].color);
+					updateMeshAsync(jobs, meshes, selectedObjectIndex, meshes[selectedObjectIndex].ctrlpts1.verts, meshes[selectedObjectIndex].ctrlpts2.verts, meshes[selectedObjectIndex].pinch1.verts, meshes[selectedObjectIndex].pinch2.verts, meshes[selectedObjectIndex].sweep.verts, precision, previewBudgetMs / 1000.0, &pool);
 
 					lines.clear();
 					modify_points.clear();
@@ -1411,6 +1613,7 @@ int main()
 			cb->noLightingViewPipeline();
 			for (Line& line : axisLines)
 			{
+				cb->updateNoLightingColor(line.col);
 				line.draw();
 			}
 		}
@@ -1434,7 +1637,17 @@ int main()
 					a -= 0.05f;
 				}
 				cb->updateShadingUniforms(lightPos, d, a);
-				meshes[i].draw();
+				cb->updateLightingColor(meshes[i].color);
+
+				// far away meshes are drawn coarser
+				LodLevel level;
+				if (levelOfDetail) {
+					glm::vec3 center;
+					float radius;
+					meshes[i].boundingsphere(center, radius);
+					level = meshes[i].chooselod(cb->projectedRadius(center, radius));
+				}
+				meshes[i].draw(level);
 				//std::cout << meshes[i].getAxis() << std::endl;
 			}
 		}
@@ -1447,6 +1660,7 @@ int main()
 			d += 0.2f;
 			a += 0.05f;
 			cb->updateShadingUniforms(lightPos, d, a);
+			cb->updateLightingColor(tempmesh.color);
 			tempmesh.draw();
 		}
 		else {
@@ -1457,6 +1671,7 @@ int main()
 			d += 0.2f;
 			a += 0.05f;
 			cb->updateShadingUniforms(lightPos, d, a);
+			cb->updateLightingColor(meshes[selectedObjectIndex].color);
 			meshes[selectedObjectIndex].draw();
 		}
 
@@ -1466,6 +1681,7 @@ int main()
 			cb->noLightingViewPipeline();
 			for (Line& line : lines)
 			{
+				cb->updateNoLightingColor(line.col);
 				line.draw();
 			}
 		}
@@ -1476,6 +1692,7 @@ int main()
 			cb->noLightingViewPipeline();
 			for (Line& ctrl : modify_points)
 			{
+				cb->updateNoLightingColor(ctrl.col);
 				ctrl.drawPoints(pointSize);
 			}
 			if (view == CROSS_EDIT || view == CROSS_DRAW) {
@@ -1483,9 +1700,16 @@ int main()
 				cb->noLightingViewPipeline();
 				for (Line& ctrl : static_points)
 				{
+					cb->updateNoLightingColor(ctrl.col);
 					ctrl.draw();
 					ctrl.drawPoints(pointSize);
 				}
+
+				// the point a cross section is being drawn from
+				if (view == CROSS_DRAW && lineInProgress != nullptr && selectedPointIndex >= 0 && selectedCurveIndex >= 0 && selectedCurveIndex < int(static_points.size())) {
+					cb->updateNoLightingColor(lineColor);
+					static_points[selectedCurveIndex].drawPoints(pointSize, selectedPointIndex, 1);
+				}
 			}
 		}
 
@@ -1495,6 +1719,7 @@ int main()
 			cb->noLightingViewPipeline();
 			for (Line &bound : bounds)
 			{
+				cb->updateNoLightingColor(bound.col);
 				bound.draw();
 			}
 		}
@@ -0,0 +1,147 @@
+//------------------------------------------------------------------------------
+// Checks that MeshJobs swaps in only the geometry of a background rebuild: a
+// colour applied to the mesh after the job was submitted has to survive
+// poll() and finish(). Runs without a window, the few GL calls an upload
+// makes go to the no-op stubs below.
+//
+//     589-tests
+//------------------------------------------------------------------------------
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glad/glad.h>
+#include <glm/gtx/io.hpp>
+
+#include "Camera.h"
+#include "Mesh.h"
+#include "MeshJobs.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static void APIENTRY genObjects(GLsizei n, GLuint* ids) {
+	static GLuint next = 1;
+	for (GLsizei i = 0; i < n; i++) {
+		ids[i] = next++;
+	}
+}
+static void APIENTRY deleteObjects(GLsizei, const GLuint*) {}
+static void APIENTRY bindArray(GLuint) {}
+static void APIENTRY bindBuffer(GLenum, GLuint) {}
+static void APIENTRY bufferData(GLenum, GLsizeiptr, const void*, GLenum) {}
+static void APIENTRY bufferSubData(GLenum, GLintptr, GLsizeiptr, const void*) {}
+static void APIENTRY attribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) {}
+static void APIENTRY enableAttrib(GLuint) {}
+
+static void stubGL() {
+	glad_glGenVertexArrays = genObjects;
+	glad_glGenBuffers = genObjects;
+	glad_glDeleteVertexArrays = deleteObjects;
+	glad_glDeleteBuffers = deleteObjects;
+	glad_glBindVertexArray = bindArray;
+	glad_glBindBuffer = bindBuffer;
+	glad_glBufferData = bufferData;
+	glad_glBufferSubData = bufferSubData;
+	glad_glVertexAttribPointer = attribPointer;
+	glad_glEnableVertexAttribArray = enableAttrib;
+}
+
+static int failures = 0;
+
+static void check(bool passed, const char* what) {
+	if (!passed) {
+		std::printf("FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+// true if the mesh and every one of its vertices have colour c
+static bool coloured(const Mesh& mesh, glm::vec3 c) {
+	if (mesh.color != c) {
+		return false;
+	}
+	for (const Vertex& v : mesh.verts) {
+		if (v.color != c) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Stands in for rebuildMesh(): precision + 1 vertices in the colour the copy
+// was taken with
+static bool rebuild(Mesh& work, int precision, size_t& first, size_t& count) {
+	work.verts.assign(size_t(precision) + 1, Vertex{ glm::vec3(0.f), work.color, glm::vec3(0.f, 0.f, 1.f) });
+	first = 0;
+	count = work.verts.size();
+	return true;
+}
+
+static Mesh startmesh(glm::vec3 color) {
+	Mesh mesh;
+	mesh.verts.assign(4, Vertex{ glm::vec3(1.f), glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f) });
+	mesh.setColor(color);
+	return mesh;
+}
+
+static const glm::vec3 red(1.f, 0.f, 0.f);
+static const glm::vec3 blue(0.f, 0.f, 1.f);
+
+// setColor() after submit(), then finish()
+static void colourBeforeFinish() {
+	MeshJobs jobs;
+	std::vector<Mesh> meshes;
+	meshes.push_back(startmesh(red));
+
+	jobs.submit(0, meshes[0], rebuild, std::vector<int>{ 16 });
+	meshes[0].setColor(blue);
+	jobs.finish(meshes);
+
+	check(meshes[0].verts.size() == 17, "finish() swaps the rebuilt geometry in");
+	check(coloured(meshes[0], blue), "a colour set before finish() survives the swap");
+}
+
+// setColor() while a progressive job is still building, polling each level in
+static void colourBetweenLevels() {
+	MeshJobs jobs;
+	std::vector<Mesh> meshes;
+	meshes.push_back(startmesh(red));
+
+	std::atomic<bool> recoloured(false);
+	MeshJobs::Build build = [&recoloured](Mesh& work, int precision, size_t& first, size_t& count) {
+		// the last level waits until the colour has changed under it
+		while (precision == 64 && !recoloured) {
+			std::this_thread::yield();
+		}
+		return rebuild(work, precision, first, count);
+	};
+	jobs.submit(0, meshes[0], build, std::vector<int>{ 16, 64 });
+
+	while (meshes[0].verts.size() != 17) {
+		jobs.poll(meshes);
+		std::this_thread::yield();
+	}
+	check(coloured(meshes[0], red), "the first level keeps the mesh colour");
+
+	meshes[0].setColor(blue);
+	recoloured = true;
+	while (meshes[0].verts.size() != 65) {
+		jobs.poll(meshes);
+		std::this_thread::yield();
+	}
+	check(coloured(meshes[0], blue), "a colour set between levels survives the next one");
+}
+
+int main() {
+	stubGL();
+
+	colourBeforeFinish();
+	colourBetweenLevels();
+
+	if (failures > 0) {
+		return 1;
+	}
+	std::printf("MeshJobs colour checks passed\n");
+	return 0;
+}